@@ -0,0 +1,162 @@
+#include "annotate.h"
+
+#include "constants.h"
+#include "notation.h"
+#include "search.h"
+#include "search_helpers.h"
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+/// @brief The grade of one move.
+struct MoveAnnotation
+{
+    int column; // the move played, 1-7
+    int score; // the score of the move played, for the side which played it
+    int best_score; // the score of the position it was played from
+    int best_column; // a move reaching best_score, 1-7
+    uint64_t nodes; // searched to grade the move
+};
+
+/// @brief The outcome of annotating one line.
+struct GameAnnotation
+{
+    bool valid;
+    std::vector<MoveAnnotation> moves; // from ply first_ply + 1 on
+};
+
+/// @brief Grade the moves of one game, solving its positions from the last one back.
+/// @param line The game's move string.
+/// @param first_ply The number of moves played before the first one graded.
+/// @return The annotation, marked invalid if the line could not be parsed.
+static GameAnnotation annotate_game(const std::string & line, int first_ply)
+{
+    GameAnnotation game{false, {}};
+
+    Bitboard our_bb, their_bb;
+    if (!parse_moves(line, our_bb, their_bb)) return game;
+    game.valid = true;
+
+    int num_plies = line.size();
+    if (first_ply >= num_plies) return game;
+
+    // the positions the moves were played from
+    std::vector<std::pair<Bitboard, Bitboard>> positions(num_plies);
+    our_bb = their_bb = Empty_BB;
+    for (int ply = 0; ply < num_plies; ++ply)
+    {
+        positions[ply] = {our_bb, their_bb};
+
+        Bitboard move = possible_moves(our_bb, their_bb) & file_bb(File(line[ply] - '1'));
+        their_bb = std::exchange(our_bb, their_bb) | move;
+    }
+
+    game.moves.resize(num_plies - first_ply);
+    reset_search_stats();
+
+    // the score of the position after the current ply's move, for the side to move there
+    int next_score = 0;
+
+    // the final position, unless the game is over (a full board being a draw)
+    if (!check_win(their_bb) && (our_bb | their_bb) != All_Tiles_BB) next_score = root_search(our_bb, their_bb, false);
+
+    for (int ply = num_plies - 1; ply >= first_ply; --ply)
+    {
+        auto [ply_our, ply_their] = positions[ply];
+        MoveAnnotation & annotation = game.moves[ply - first_ply];
+
+        annotation.column = line[ply] - '1' + 1;
+
+        // the positions after this one warmed the table up, both for the best move and the others
+        Bitboard best_move;
+        annotation.best_score = find_best_move(ply_our, ply_their, best_move, false);
+        annotation.best_column = move_column(best_move);
+
+        // a winning move ends the game, scored as negamax does
+        Bitboard played = ply_our | (possible_moves(ply_our, ply_their) & file_bb(File(line[ply] - '1')));
+        int depth_left = NUM_STONES - popcount(ply_our|ply_their);
+        annotation.score = check_win(played) ? depth_left + 1 : -next_score;
+
+        // the nodes include the final position's search, graded along with the last move
+        annotation.nodes = search_stats().nodes;
+        reset_search_stats();
+
+        next_score = annotation.best_score;
+    }
+
+    return game;
+}
+
+AnnotateSummary run_annotate(std::istream & in, std::ostream & out, int num_workers, int first_ply)
+{
+    num_workers = std::max(1, num_workers);
+    first_ply = std::max(0, first_ply);
+
+    prepare_worker_search();
+
+    AnnotateSummary summary{0, 0, 0, 0.0};
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::string> lines;
+    std::vector<GameAnnotation> games;
+    std::string buffer;
+    std::string line;
+    size_t game_number = 0;
+
+    lines.reserve(ANNOTATE_CHUNK_SIZE);
+
+    while (in)
+    {
+        // read a chunk
+        lines.clear();
+        while (lines.size() < ANNOTATE_CHUNK_SIZE && std::getline(in, line))
+        {
+            // tolerate CRLF input and blank lines
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (!line.empty()) lines.push_back(line);
+        }
+
+        if (lines.empty()) break;
+
+        // annotate it, each worker taking the next game not started yet
+        solve_chunk(lines.size(), num_workers, games, [&](size_t i) { return annotate_game(lines[i], first_ply); });
+
+        // write it in input order
+        buffer.clear();
+        for (const GameAnnotation & game : games)
+        {
+            std::string prefix = std::to_string(++game_number) + ',';
+
+            if (!game.valid)
+            {
+                buffer += prefix + "invalid\n";
+                ++summary.num_invalid;
+                continue;
+            }
+
+            for (size_t i = 0; i < game.moves.size(); ++i)
+            {
+                const MoveAnnotation & m = game.moves[i];
+                buffer += prefix + std::to_string(first_ply + i + 1) + ',' + std::to_string(m.column) + ','
+                        + std::to_string(m.score) + ',' + std::to_string(m.best_score) + ','
+                        + std::to_string(m.best_column) + ',' + std::to_string(m.nodes) + '\n';
+            }
+
+            ++summary.num_games;
+            summary.num_moves += game.moves.size();
+        }
+
+        out.write(buffer.data(), buffer.size());
+    }
+
+    out.flush();
+
+    summary.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    return summary;
+}
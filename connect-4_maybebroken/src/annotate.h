@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <iostream>
+
+
+/// @brief Totals for an annotation run.
+struct AnnotateSummary
+{
+    size_t num_games; // valid games annotated
+    size_t num_moves; // moves annotated in them
+    size_t num_invalid; // lines which could not be parsed
+    double seconds; // wall-clock time of the whole run
+};
+
+/// @brief Grade the moves of recorded games, one per line as a move string (see parse_moves).
+/// A game may end with a winning move or a full board. Each game's positions are solved from the last one back
+/// to the first, so that the transposition table, warmed by the later plies, speeds up the earlier ones; a move's
+/// score is then the negated score of the position it led to, and only the best move needs searching for.
+/// Games are read in chunks of ANNOTATE_CHUNK_SIZE, each chunk being annotated by a pool of worker threads
+/// sharing the global transposition table (each worker taking whole games), then written in input order.
+/// Each output line is "game,ply,move,score,best_score,best_move,nodes", with the game numbered from 1 in input
+/// order, the ply from 1, the moves as columns 1-7 and the nodes searched for that ply; or "game,invalid"
+/// if the line could not be parsed. Empty lines are skipped.
+/// Search progress output is turned off and each worker searches on a single thread.
+/// @param in The games.
+/// @param out Receives the annotations.
+/// @param num_workers The number of worker threads, at least 1.
+/// @param first_ply The first ply to annotate: earlier moves are played but not graded, as positions near
+/// the start are only solved quickly with an opening book.
+/// @return The run's totals.
+AnnotateSummary run_annotate(std::istream & in, std::ostream & out, int num_workers, int first_ply);
@@ -0,0 +1,188 @@
+#include "batch.h"
+
+#include "constants.h"
+#include "notation.h"
+#include "search.h"
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+
+/// @brief The outcome of solving one line.
+struct BatchResult
+{
+    bool valid;
+    int score;
+    int best_column;
+    uint64_t nodes;
+    long long time_us;
+};
+
+/// @brief Solve one position.
+/// @param our_bb Our pieces.
+/// @param their_bb Our opponent's pieces.
+/// @return The result.
+static BatchResult solve_position(Bitboard our_bb, Bitboard their_bb)
+{
+    auto start = std::chrono::steady_clock::now();
+    reset_search_stats();
+
+    Bitboard best_move;
+    int score = find_best_move(our_bb, their_bb, best_move, false);
+
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    return BatchResult{true, score, move_column(best_move), search_stats().nodes,
+                       std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count()};
+}
+
+/// @brief Solve one position.
+/// @param line The position's text.
+/// @return The result, marked invalid if the line could not be parsed.
+static BatchResult solve_line(const std::string & line)
+{
+    Bitboard our_bb, their_bb;
+
+    if (!parse_position(line, our_bb, their_bb)) return BatchResult{false, 0, 0, 0, 0};
+
+    return solve_position(our_bb, their_bb);
+}
+
+/// @brief Append a result to an output buffer, after its position's text.
+static void write_result(const BatchResult & r, std::string & buffer)
+{
+    buffer += ',' + std::to_string(r.score) + ',' + std::to_string(r.best_column) + ','
+            + std::to_string(r.nodes) + ',' + std::to_string(r.time_us) + '\n';
+}
+
+BatchSummary run_batch(std::istream & in, std::ostream & out, int num_workers)
+{
+    num_workers = std::max(1, num_workers);
+
+    prepare_worker_search();
+
+    BatchSummary summary{0, 0, 0, 0.0};
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::string> lines;
+    std::vector<BatchResult> results;
+    std::string buffer;
+    std::string line;
+
+    lines.reserve(BATCH_CHUNK_SIZE);
+
+    while (in)
+    {
+        // read a chunk
+        lines.clear();
+        while (lines.size() < BATCH_CHUNK_SIZE && std::getline(in, line))
+        {
+            // tolerate CRLF input and blank lines
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (!line.empty()) lines.push_back(line);
+        }
+
+        if (lines.empty()) break;
+
+        // solve it
+        solve_chunk(lines.size(), num_workers, results, [&](size_t i) { return solve_line(lines[i]); });
+
+        // write it in input order
+        buffer.clear();
+        for (size_t i = 0; i < lines.size(); ++i)
+        {
+            // keep the output comma-separated whatever the input separator
+            std::string position = lines[i];
+            std::replace(position.begin(), position.end(), ',', ' ');
+
+            buffer += position;
+
+            const BatchResult & r = results[i];
+            if (!r.valid)
+            {
+                buffer += ",invalid\n";
+                ++summary.num_invalid;
+                continue;
+            }
+
+            write_result(r, buffer);
+            ++summary.num_positions;
+        }
+
+        out.write(buffer.data(), buffer.size());
+    }
+
+    out.flush();
+
+    summary.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    return summary;
+}
+
+BatchSummary run_batch_corpus(const Corpus & corpus, std::ostream & out, int num_workers)
+{
+    num_workers = std::max(1, num_workers);
+
+    prepare_worker_search();
+
+    BatchSummary summary{0, 0, 0, 0.0};
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<BatchResult> results;
+    std::string buffer;
+
+    for (size_t first = 0; first < corpus.size(); first += BATCH_CHUNK_SIZE)
+    {
+        size_t count = std::min(BATCH_CHUNK_SIZE, corpus.size() - first);
+
+        // the records are read in place, only checked
+        solve_chunk(count, num_workers, results, [&](size_t i)
+        {
+            const CorpusRecord & record = corpus[first + i];
+            if (!valid_position(record.our(), record.their())) return BatchResult{false, 0, 0, 0, 0};
+            return solve_position(record.our(), record.their());
+        });
+
+        // write it in corpus order
+        buffer.clear();
+        for (size_t i = 0; i < count; ++i)
+        {
+            const CorpusRecord & record = corpus[first + i];
+
+            char position[64];
+            std::snprintf(position, sizeof(position), "%#llx %#llx", static_cast<unsigned long long>(record.our()),
+                          static_cast<unsigned long long>(record.their()));
+            buffer += position;
+
+            const BatchResult & r = results[i];
+            if (!r.valid)
+            {
+                buffer += ",invalid\n";
+                ++summary.num_invalid;
+                continue;
+            }
+
+            write_result(r, buffer);
+            ++summary.num_positions;
+
+            if (record.has_score() && record.score() != r.score)
+            {
+                std::cerr << "record " << first + i << " (" << position << ") scored " << r.score
+                          << ", expected " << record.score() << '\n';
+                ++summary.num_mismatches;
+            }
+        }
+
+        out.write(buffer.data(), buffer.size());
+    }
+
+    out.flush();
+
+    summary.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    return summary;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "corpus.h"
+
+#include <cstddef>
+#include <iostream>
+
+
+/// @brief Totals for a batch run.
+struct BatchSummary
+{
+    size_t num_positions; // valid positions solved
+    size_t num_invalid; // lines which could not be parsed, or corpus records which aren't positions
+    size_t num_mismatches; // corpus records whose stored score differs from the one found
+    double seconds; // wall-clock time of the whole run
+};
+
+/// @brief Solve a stream of positions, one per line, as move strings or bitboard pairs (see parse_position).
+/// Lines are read in chunks of BATCH_CHUNK_SIZE, each chunk being solved by a pool of worker threads
+/// sharing the global transposition table, then written in input order with one buffered write.
+/// Each output line is "position,score,best_move,nodes,time_us", with the best move as a column 1-7
+/// (0 if there is none), or "position,invalid" if the line could not be parsed. Empty lines are skipped.
+/// Search progress output is turned off and each worker searches on a single thread.
+/// @param in The positions.
+/// @param out Receives the results.
+/// @param num_workers The number of worker threads, at least 1.
+/// @return The run's totals.
+BatchSummary run_batch(std::istream & in, std::ostream & out, int num_workers);
+
+/// @brief Solve every position of a corpus, like run_batch: in chunks of BATCH_CHUNK_SIZE records, read in place.
+/// Each output line is "our their,score,best_move,nodes,time_us", with the record's bitboards in hexadecimal
+/// (see parse_position), or "our their,invalid" if the record isn't a valid position. Records whose stored score
+/// differs from the one found are reported on stderr and counted.
+/// @param corpus The positions.
+/// @param out Receives the results.
+/// @param num_workers The number of worker threads, at least 1.
+/// @return The run's totals.
+BatchSummary run_batch_corpus(const Corpus & corpus, std::ostream & out, int num_workers);
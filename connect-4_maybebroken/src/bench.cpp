@@ -0,0 +1,236 @@
+// Benchmark: solves fixed position sets and reports timing, node and TT statistics.
+//
+// Usage: bench [--threads N] [--sorter scalar|avx2|avx512] [--etc on|off] [--threats on|off] [--tt-size MB] [set files...]
+// Without set files, the sets checked into bench/ are used. Each set file holds one
+// "moves score" line per position ('#' starts a comment line). The transposition table is
+// cleared before every position, so results don't depend on the order positions are solved in.
+// The TT occupancy reported is the mean number of entries in use after each position.
+// A human-readable report goes to stderr, and one JSON object per set to stdout.
+// The exit status is non-zero if any score differs from its reference.
+
+#include "notation.h"
+#include "search.h"
+#include "tt.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef BENCH_DIR
+#define BENCH_DIR "bench"
+#endif
+
+
+/// @brief Results of solving one set.
+struct SetResult
+{
+    std::string name;
+    std::vector<double> times; // seconds, per position
+    SearchStats stats = {};
+    uint64_t tt_used = 0; // TT entries in use after each solve, summed
+    int mismatches = 0;
+};
+
+/// @brief Get a percentile of sorted values (nearest rank).
+/// @param sorted The values, in increasing order. Must not be empty.
+/// @param p The percentile, in [0; 100].
+/// @return The value at that percentile.
+static double percentile(const std::vector<double> & sorted, double p)
+{
+    size_t rank = static_cast<size_t>(p / 100.0 * sorted.size() + 0.5);
+    return sorted[std::min(sorted.size() - 1, rank ? rank - 1 : 0)];
+}
+
+/// @brief Get a set's name from its file path (the file name without directory and extension).
+static std::string set_name(const std::string & path)
+{
+    size_t begin = path.find_last_of('/');
+    begin = (begin == std::string::npos) ? 0 : begin + 1;
+
+    size_t end = path.find_last_of('.');
+    if (end == std::string::npos || end < begin) end = path.size();
+
+    return path.substr(begin, end - begin);
+}
+
+/// @brief Solve every position of a set file.
+/// @param path The set file.
+/// @param result Receives the set's results.
+/// @return Whether the file could be read.
+static bool run_set(const std::string & path, SetResult & result)
+{
+    std::ifstream file(path);
+    if (!file) return false;
+
+    result.name = set_name(path);
+
+    std::string line;
+    while (std::getline(file, line))
+    {
+        if (line.empty() || line[0] == '#') continue;
+
+        std::istringstream fields(line);
+        std::string moves;
+        int expected;
+
+        Bitboard our_bb, their_bb;
+        if (!(fields >> moves >> expected) || !parse_position(moves, our_bb, their_bb))
+        {
+            std::cerr << path << ": bad line \"" << line << "\"\n";
+            ++result.mismatches;
+            continue;
+        }
+
+        tt.clear();
+        reset_search_stats();
+
+        auto start = std::chrono::steady_clock::now();
+        int score = root_search(our_bb, their_bb, false);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        result.times.push_back(elapsed.count());
+        result.stats += search_stats();
+        result.tt_used += tt.used_entries();
+
+        if (score != expected)
+        {
+            std::cerr << result.name << ": " << moves << " scored " << score << ", expected " << expected << '\n';
+            ++result.mismatches;
+        }
+    }
+
+    return true;
+}
+
+/// @brief Print a set's results, for humans to stderr and as a JSON object to stdout.
+static void report(const SetResult & result)
+{
+    std::vector<double> sorted = result.times;
+    std::sort(sorted.begin(), sorted.end());
+
+    double total = 0.0;
+    for (double t : sorted) total += t;
+
+    size_t count = sorted.size();
+    double mean = count ? total / count : 0.0;
+    double p50 = count ? percentile(sorted, 50) : 0.0;
+    double p90 = count ? percentile(sorted, 90) : 0.0;
+    double p99 = count ? percentile(sorted, 99) : 0.0;
+    double max = count ? sorted.back() : 0.0;
+    double nps = total > 0.0 ? result.stats.nodes / total : 0.0;
+    double hit_rate = result.stats.tt_probes ? static_cast<double>(result.stats.tt_hits) / result.stats.tt_probes : 0.0;
+    double tt_used = count ? static_cast<double>(result.tt_used) / count : 0.0;
+
+    std::cerr << result.name << ": " << count << " positions, " << result.mismatches << " mismatches\n"
+              << "  time (ms): mean " << mean*1e3 << ", p50 " << p50*1e3 << ", p90 " << p90*1e3
+              << ", p99 " << p99*1e3 << ", max " << max*1e3 << ", total " << total*1e3 << '\n'
+              << "  nodes " << result.stats.nodes << ", nodes/s " << nps << ", TT hit rate " << hit_rate
+              << ", TT entries used " << tt_used << '\n';
+
+    if (SEARCH_STATS_ENABLED) print_search_stats(result.stats, std::cerr);
+
+    uint64_t cutoffs = 0;
+    for (uint64_t count : result.stats.cutoffs_by_move) cutoffs += count;
+    double first_move_cutoff_rate = cutoffs ? static_cast<double>(result.stats.cutoffs_by_move[0]) / cutoffs : 0.0;
+
+    std::cout << "{\"set\":\"" << result.name << "\",\"positions\":" << count
+              << ",\"mismatches\":" << result.mismatches
+              << ",\"mean_ms\":" << mean*1e3 << ",\"p50_ms\":" << p50*1e3 << ",\"p90_ms\":" << p90*1e3
+              << ",\"p99_ms\":" << p99*1e3 << ",\"max_ms\":" << max*1e3 << ",\"total_ms\":" << total*1e3
+              << ",\"nodes\":" << result.stats.nodes << ",\"nodes_per_sec\":" << nps
+              << ",\"tt_probes\":" << result.stats.tt_probes << ",\"tt_hit_rate\":" << hit_rate
+              << ",\"tt_used_entries\":" << tt_used;
+
+    // detailed statistics, only meaningful in SEARCH_STATS builds
+    if (SEARCH_STATS_ENABLED)
+    {
+        std::cout << ",\"tt_stores\":" << result.stats.tt_stores << ",\"tt_overwrites\":" << result.stats.tt_overwrites
+                  << ",\"early_prunes\":" << result.stats.early_prunes << ",\"tt_lower_cutoffs\":" << result.stats.tt_lower_cutoffs
+                  << ",\"etc_cutoffs\":" << result.stats.etc_cutoffs
+                  << ",\"threat_cutoffs\":" << result.stats.threat_cutoffs
+                  << ",\"beta_cutoffs\":" << cutoffs
+                  << ",\"first_move_cutoff_rate\":" << first_move_cutoff_rate
+                  << ",\"null_window_iterations\":" << result.stats.null_window_iterations;
+    }
+
+    std::cout << "}\n";
+}
+
+int main(int argc, char *argv[])
+{
+    std::vector<std::string> paths;
+    bool etc = ETC_DEFAULT;
+    bool threats = THREAT_ANALYSIS_DEFAULT;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--threads") == 0 && i+1 < argc) set_search_threads(std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--sorter") == 0 && i+1 < argc)
+        {
+            MoveSorter sorter;
+            if (!parse_move_sorter(argv[++i], sorter) || !set_move_sorter(sorter))
+            {
+                std::cerr << "Unsupported move sorter " << argv[i] << '\n';
+                return EXIT_FAILURE;
+            }
+        }
+        else if (std::strcmp(argv[i], "--tt-size") == 0 && i+1 < argc)
+        {
+            if (!tt.resize(std::strtoull(argv[++i], nullptr, 10)))
+            {
+                std::cerr << "Could not allocate a " << argv[i] << "MB transposition table\n";
+                return EXIT_FAILURE;
+            }
+        }
+        else if (std::strcmp(argv[i], "--etc") == 0 && i+1 < argc)
+        {
+            etc = std::strcmp(argv[++i], "off") != 0;
+            set_enhanced_transposition_cutoffs(etc);
+        }
+        else if (std::strcmp(argv[i], "--threats") == 0 && i+1 < argc)
+        {
+            threats = std::strcmp(argv[++i], "off") != 0;
+            set_threat_analysis(threats);
+        }
+        else paths.push_back(argv[i]);
+    }
+
+    if (paths.empty())
+    {
+        // from the fastest set to the slowest
+        for (const char * name : {"end", "middle", "start"})
+        {
+            paths.push_back(std::string(BENCH_DIR) + "/" + name + ".txt");
+        }
+    }
+
+    set_search_verbose(false);
+
+    std::cerr << "move sorter: " << move_sorter_name(get_move_sorter()) << ", enhanced transposition cutoffs: "
+              << (etc ? "on" : "off") << ", threat analysis: " << (threats ? "on" : "off")
+              << ", transposition table: " << tt.num_buckets() << " buckets\n";
+
+    int mismatches = 0;
+
+    for (const std::string & path : paths)
+    {
+        SetResult result;
+
+        if (!run_set(path, result))
+        {
+            std::cerr << "Could not open " << path << '\n';
+            return EXIT_FAILURE;
+        }
+
+        report(result);
+        mismatches += result.mismatches;
+    }
+
+    return mismatches ? EXIT_FAILURE : EXIT_SUCCESS;
+}
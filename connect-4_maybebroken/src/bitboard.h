@@ -9,6 +9,8 @@
 #pragma once
 
 
+#include "geometry.h"
+
 #include <cstdint>
 
 
@@ -56,7 +58,12 @@ constexpr File operator--(File& f, int)
 
 
 
-using Bitboard = uint64_t;
+// The board the solver plays on. The named squares, files and ranks below assume its size.
+using StandardGeometry = BoardGeometry<7, 6>;
+
+using Bitboard = StandardGeometry::Board;
+
+static_assert(NUM_BB_SQUARE_BITS == StandardGeometry::NUM_BITS, "one Square per bit of the standard board");
 
 
 
@@ -98,6 +105,14 @@ constexpr Square bb_square(Bitboard bb)
     return static_cast<Square>(__builtin_ctzll(bb)); // count zeros, long long (64-bit)
 }
 
+/// @brief Get the file of a square.
+/// @param s The square
+/// @return The file
+constexpr File square_file(Square s)
+{
+    return static_cast<File>(s / 7);
+}
+
 
 // Overloads of bitwise operators between a Bitboard and a Square for testing
 // whether a given bit is set in a bitboard, and for setting and clearing bits.
@@ -122,25 +137,68 @@ constexpr Bitboard Empty_BB = 0ULL;
 
 // these do not include the sentinel rank
 
-constexpr Bitboard FileA_BB = (SQ_A1|SQ_A2|SQ_A3|SQ_A4|SQ_A5|SQ_A6);
-constexpr Bitboard FileB_BB = FileA_BB << (7 * 1);
-constexpr Bitboard FileC_BB = FileA_BB << (7 * 2);
-constexpr Bitboard FileD_BB = FileA_BB << (7 * 3);
-constexpr Bitboard FileE_BB = FileA_BB << (7 * 4);
-constexpr Bitboard FileF_BB = FileA_BB << (7 * 5);
-constexpr Bitboard FileG_BB = FileA_BB << (7 * 6);
+constexpr Bitboard FileA_BB = StandardGeometry::file(File_A);
+constexpr Bitboard FileB_BB = StandardGeometry::file(File_B);
+constexpr Bitboard FileC_BB = StandardGeometry::file(File_C);
+constexpr Bitboard FileD_BB = StandardGeometry::file(File_D);
+constexpr Bitboard FileE_BB = StandardGeometry::file(File_E);
+constexpr Bitboard FileF_BB = StandardGeometry::file(File_F);
+constexpr Bitboard FileG_BB = StandardGeometry::file(File_G);
+
+static_assert(FileA_BB == (SQ_A1|SQ_A2|SQ_A3|SQ_A4|SQ_A5|SQ_A6), "files are stacked from bit 0");
+
+/// @brief Construct a bitboard of a whole file.
+/// @param f The file
+/// @return The bitboard
+constexpr Bitboard file_bb(File f)
+{
+    return StandardGeometry::file(f);
+}
 
 
 // accounting for sentinel
 
-constexpr Bitboard Rank1_BB = (SQ_A1|SQ_B1|SQ_C1|SQ_D1|SQ_E1|SQ_F1|SQ_G1);
+constexpr Bitboard Rank1_BB = StandardGeometry::Bottom_BB;
 constexpr Bitboard Rank2_BB = Rank1_BB << 1;
 constexpr Bitboard Rank3_BB = Rank1_BB << 2;
 constexpr Bitboard Rank4_BB = Rank1_BB << 3;
 constexpr Bitboard Rank5_BB = Rank1_BB << 4;
 constexpr Bitboard Rank6_BB = Rank1_BB << 5;
-constexpr Bitboard Rank_Sentinel_BB = Rank1_BB << 6; // sentinel rank
+constexpr Bitboard Rank_Sentinel_BB = StandardGeometry::Sentinel_BB; // sentinel rank
 
 // All tiles, without sentinel rank
-constexpr Bitboard All_Tiles_BB =
-                    (Rank1_BB|Rank2_BB|Rank3_BB|Rank4_BB|Rank5_BB|Rank6_BB);
\ No newline at end of file
+constexpr Bitboard All_Tiles_BB = StandardGeometry::All_Tiles_BB;
+
+// ranks by parity, for zugzwang (see threats.h)
+constexpr Bitboard Odd_Ranks_BB = StandardGeometry::Odd_Ranks_BB;
+constexpr Bitboard Even_Ranks_BB = StandardGeometry::Even_Ranks_BB;
+
+static_assert(Rank1_BB == (SQ_A1|SQ_B1|SQ_C1|SQ_D1|SQ_E1|SQ_F1|SQ_G1), "rank 1 is the bottom of each file");
+static_assert(All_Tiles_BB == (Rank1_BB|Rank2_BB|Rank3_BB|Rank4_BB|Rank5_BB|Rank6_BB), "all tiles are ranks 1 to 6");
+static_assert(Odd_Ranks_BB == (Rank1_BB|Rank3_BB|Rank5_BB) && Even_Ranks_BB == (Rank2_BB|Rank4_BB|Rank6_BB), "ranks by parity");
+static_assert(Rank_Sentinel_BB == (SQ_A_SENTINEL|SQ_B_SENTINEL|SQ_C_SENTINEL|SQ_D_SENTINEL|SQ_E_SENTINEL|SQ_F_SENTINEL|SQ_G_SENTINEL),
+              "the sentinel rank tops each file");
+
+
+/// @brief Mirror a bitboard left to right (file A <-> file G, B <-> F, C <-> E), sentinel rank included.
+/// Same result as mirror<StandardGeometry>, in a fixed number of steps.
+/// @param bb The bitboard
+/// @return The mirrored bitboard
+constexpr Bitboard mirror_bb(Bitboard bb)
+{
+    // files are 7-bit groups: swap files A-C with files E-G as one 21-bit block each, D staying in place...
+    constexpr Bitboard Low_Files = (1ULL << (7 * 3)) - 1; // files A, B and C
+    constexpr Bitboard Middle_File = 0x7FULL << (7 * 3); // file D
+    bb = ((bb & Low_Files) << (7 * 4)) | ((bb >> (7 * 4)) & Low_Files) | (bb & Middle_File);
+
+    // ...then swap the outer files of each block (A <-> C and E <-> G), B and F staying in place
+    constexpr Bitboard Outer_Files = 0x7FULL | (0x7FULL << (7 * 4)); // files A and E
+    constexpr Bitboard Inner_Files = Outer_Files << 7; // files B and F
+    return ((bb & Outer_Files) << (7 * 2)) | ((bb >> (7 * 2)) & Outer_Files) | (bb & (Inner_Files | Middle_File));
+}
+
+static_assert(mirror_bb(FileA_BB) == FileG_BB && mirror_bb(FileB_BB) == FileF_BB && mirror_bb(FileC_BB) == FileE_BB,
+              "mirroring swaps the outer files");
+static_assert(mirror_bb(FileD_BB | Rank_Sentinel_BB) == (FileD_BB | Rank_Sentinel_BB), "mirroring keeps the center file");
+static_assert(mirror_bb(mirror_bb(0x1234'5678'9ABCULL)) == 0x1234'5678'9ABCULL, "mirroring is an involution");
+static_assert(mirror_bb(0x1234'5678'9ABCULL) == mirror<StandardGeometry>(0x1234'5678'9ABCULL), "same as the generic mirror");
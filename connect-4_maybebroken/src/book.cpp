@@ -0,0 +1,141 @@
+#include "book.h"
+
+#include "headered_file.h"
+#include "tt.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "the opening book file is little-endian");
+
+OpeningBook book;
+
+bool OpeningBook::open(const char * path)
+{
+    close();
+
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    size_t map_size = static_cast<size_t>(st.st_size);
+    void * map = mmap(nullptr, map_size, PROT_READ, MAP_SHARED, fd, 0);
+
+    // the mapping stays valid after the descriptor is closed
+    ::close(fd);
+
+    if (map == MAP_FAILED) return false;
+
+    FileHeader header = {};
+    if (map_size >= BOOK_FILE_HEADER_SIZE) std::memcpy(&header, map, sizeof(header));
+
+    if (header.magic == BOOK_FILE_MAGIC)
+    {
+        // sorted book from bookgen: header, keys block, then values block
+        size_t data_size = map_size - BOOK_FILE_HEADER_SIZE;
+
+        if (header.version != BOOK_FILE_VERSION || data_size % BOOK_SORTED_ENTRY_SIZE != 0
+            || data_size / BOOK_SORTED_ENTRY_SIZE != header.num_entries)
+        {
+            munmap(map, map_size);
+            return false;
+        }
+
+        m_num_entries = header.num_entries;
+        m_sorted_keys = reinterpret_cast<const uint64_t *>(static_cast<const char *>(map) + BOOK_FILE_HEADER_SIZE);
+        m_vals = reinterpret_cast<const int8_t *>(m_sorted_keys + m_num_entries);
+    }
+    else
+    {
+        // hashed book from tools/little_endian.py: keys block first, then values block
+        if (map_size % BOOK_ENTRY_SIZE != 0)
+        {
+            munmap(map, map_size);
+            return false;
+        }
+
+        m_num_entries = map_size / BOOK_ENTRY_SIZE;
+        m_keys = static_cast<const uint32_t *>(map);
+        m_vals = reinterpret_cast<const int8_t *>(m_keys + m_num_entries);
+    }
+
+    // probes hit scattered slots, readahead would only waste I/O
+    madvise(map, map_size, MADV_RANDOM);
+
+    m_map = map;
+    m_map_size = map_size;
+
+    return true;
+}
+
+void OpeningBook::close()
+{
+    if (m_map) munmap(m_map, m_map_size);
+
+    m_map = nullptr;
+    m_map_size = 0;
+    m_num_entries = 0;
+    m_keys = nullptr;
+    m_sorted_keys = nullptr;
+    m_vals = nullptr;
+}
+
+int8_t OpeningBook::probe(Bitboard our_bb, Bitboard their_bb) const
+{
+    if (!m_map) return TT_NOT_FOUND;
+
+    if (m_sorted_keys)
+    {
+        TTKey key = make_canonical_key(our_bb, their_bb);
+
+        const uint64_t * end = m_sorted_keys + m_num_entries;
+        const uint64_t * found = std::lower_bound(m_sorted_keys, end, key);
+
+        return (found != end && *found == key) ? m_vals[found - m_sorted_keys] : TT_NOT_FOUND;
+    }
+
+    TTKey full_key = make_key(our_bb, their_bb);
+
+    // mirror images have the same score, the book may only hold one of them
+    for (TTKey key : {full_key, mirror_bb(full_key)})
+    {
+        // same indexing as the transposition table
+        size_t index = key % m_num_entries;
+
+        // if the truncated key matches the computed truncated key, return the associated value
+        // (Chinese remainder theorem)
+        if (m_keys[index] == static_cast<uint32_t>(key)) return m_vals[index];
+    }
+
+    return TT_NOT_FOUND; // no match
+}
+
+bool OpeningBook::write_sorted(const char * path, std::vector<BookEntry> & entries)
+{
+    std::sort(entries.begin(), entries.end(), [](const BookEntry & a, const BookEntry & b) { return a.key < b.key; });
+
+    HeaderedFileWriter file;
+    if (!file.open(path, BOOK_FILE_HEADER_SIZE)) return false;
+
+    for (const BookEntry & entry : entries)
+    {
+        uint64_t key = entry.key;
+        file.write(&key, sizeof(key));
+    }
+
+    for (const BookEntry & entry : entries) file.write(&entry.value, sizeof(entry.value));
+
+    FileHeader header{BOOK_FILE_MAGIC, BOOK_FILE_VERSION, entries.size()};
+    return file.close(&header, sizeof(header));
+}
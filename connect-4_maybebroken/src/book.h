@@ -0,0 +1,86 @@
+#pragma once
+
+#include "bitboard.h"
+
+#include "constants.h"
+#include "tt.h"
+
+#include <vector>
+
+
+/// @brief A position's score, as stored in a sorted book file.
+struct BookEntry
+{
+    TTKey key; // the position's canonical key, see make_canonical_key
+    int8_t value; // the position's score, as returned by root_search
+};
+
+/// @brief A read-only opening book, memory-mapped from a file produced by tools/little_endian.py or by bookgen.
+/// Files from tools/little_endian.py are looked up like the transposition table: the slot is the position key modulo
+/// the number of entries, and the stored 32-bit partial key is unique thanks to the Chinese remainder theorem.
+/// Files from bookgen hold sorted canonical keys, which are binary searched.
+/// Values are scores from the point of view of the side to move, as returned by root_search.
+class OpeningBook
+{
+public:
+    OpeningBook() = default;
+
+    /// @brief NO COPY CONSTRUCTOR ALLOWED
+    OpeningBook(const OpeningBook&) = delete;
+
+    ~OpeningBook()
+    {
+        close();
+    }
+
+    /// @brief Map a book file into memory. No data is copied; pages are loaded on demand.
+    /// Any previously opened book is closed first.
+    /// @param path The book file's path.
+    /// @return Whether the book was opened successfully.
+    bool open(const char * path);
+
+    /// @brief Unmap the book, if any.
+    void close();
+
+    /// @brief Check whether a book is currently mapped.
+    /// @return Whether the book can be probed.
+    bool is_open() const { return m_map != nullptr; }
+
+    /// @brief Get the number of entries (slots) in the book.
+    /// @return The number of entries, 0 if no book is mapped.
+    size_t num_entries() const { return m_num_entries; }
+
+    /// @brief Look up a position in the book.
+    /// @param our_bb Our pieces.
+    /// @param their_bb Their pieces.
+    /// @return The score stored for the position if it exists, TT_NOT_FOUND if it wasn't found.
+    int8_t probe(Bitboard our_bb, Bitboard their_bb) const;
+
+    /// @brief Write a sorted book file, which open loads directly.
+    /// @param path The file's path, replaced only once the whole file is written.
+    /// @param entries The positions, one entry per canonical key. Sorted in place.
+    /// @return Whether the file was written successfully.
+    static bool write_sorted(const char * path, std::vector<BookEntry> & entries);
+
+private:
+    /// @brief Header of a sorted book file, padded to BOOK_FILE_HEADER_SIZE bytes.
+    struct FileHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t num_entries;
+    };
+
+    static_assert(sizeof(FileHeader) <= BOOK_FILE_HEADER_SIZE, "header must fit its padded block");
+
+    void * m_map = nullptr; // the whole mapped file
+    size_t m_map_size = 0; // size of the mapping, in bytes
+    size_t m_num_entries = 0;
+    const uint32_t * m_keys = nullptr; // points into the mapping, for files from tools/little_endian.py
+    const uint64_t * m_sorted_keys = nullptr; // points into the mapping, for files from bookgen
+    const int8_t * m_vals = nullptr; // points into the mapping, right after the keys
+};
+
+
+// The global opening book, empty until opened.
+extern OpeningBook book;
@@ -0,0 +1,255 @@
+// Opening book generator: solves every position up to a given number of plies and writes them to a sorted book.
+//
+// Usage: bookgen --out PATH [--ply N] [--root MOVES] [--workers N] [--checkpoint PATH] [--tt-size MB]
+// Positions are enumerated ply by ply from the empty board, or from the position after MOVES (N then counting
+// the moves played after it). Mirror images count once, with the same canonical keys as the transposition table.
+// They are solved with root_search by a pool of workers, deepest plies first, so that the shallow,
+// expensive positions start with a warm transposition table.
+// Every solved position is appended to the checkpoint file (PATH.ckpt by default) as a "key score" line;
+// running the same command again skips them, so an interrupted run resumes where it stopped.
+// The book is written once everything is solved, and can be passed to connect4 with --book.
+
+#include "book.h"
+#include "notation.h"
+#include "search.h"
+#include "search_helpers.h"
+#include "tt.h"
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <unistd.h>
+
+
+/// @brief A position to solve.
+struct BookPosition
+{
+    Bitboard our_bb;
+    Bitboard their_bb;
+    TTKey key; // canonical key
+};
+
+/// @brief Enumerate the positions reachable from a root, one per canonical key, where the game isn't over.
+/// @param root The root position, where the game isn't over.
+/// @param max_ply The number of moves played from the root in the deepest positions.
+/// @return The positions, deepest ply first.
+static std::vector<BookPosition> enumerate_positions(BookPosition root, int max_ply)
+{
+    std::vector<std::vector<BookPosition>> plies(1, {root});
+
+    for (int ply = 1; ply <= max_ply; ++ply)
+    {
+        std::vector<BookPosition> next;
+
+        for (const BookPosition & pos : plies.back())
+        {
+            for (Bitboard moves = possible_moves(pos.our_bb, pos.their_bb); moves; moves &= moves - 1)
+            {
+                Bitboard child_their = pos.our_bb | (moves & -moves);
+
+                // the game ends there, there is nothing to solve
+                if (check_win(child_their)) continue;
+
+                next.push_back(BookPosition{pos.their_bb, child_their, make_canonical_key(pos.their_bb, child_their)});
+            }
+        }
+
+        // transpositions and mirror images are solved once
+        auto by_key = [](const BookPosition & a, const BookPosition & b) { return a.key < b.key; };
+        auto same_key = [](const BookPosition & a, const BookPosition & b) { return a.key == b.key; };
+        std::sort(next.begin(), next.end(), by_key);
+        next.erase(std::unique(next.begin(), next.end(), same_key), next.end());
+
+        std::cerr << "ply " << ply << ": " << next.size() << " positions\n";
+
+        plies.push_back(std::move(next));
+    }
+
+    std::vector<BookPosition> positions;
+    for (auto ply = plies.rbegin(); ply != plies.rend(); ++ply)
+    {
+        positions.insert(positions.end(), ply->begin(), ply->end());
+    }
+
+    return positions;
+}
+
+/// @brief Read the positions solved by previous runs, then cut off any line left incomplete by a crash,
+/// so that new lines are appended after complete ones.
+/// @param path The checkpoint file's path.
+/// @param solved Receives the score of each canonical key found.
+/// @return The number of positions read, 0 if the file doesn't exist.
+static size_t load_checkpoint(const char * path, std::unordered_map<TTKey, int8_t> & solved)
+{
+    std::FILE * file = std::fopen(path, "r");
+    if (!file) return 0;
+
+    size_t count = 0;
+    long complete_size = 0; // size of the complete lines read so far
+    char line[64];
+
+    // a line cut short has no newline, and ends the file
+    while (std::fgets(line, sizeof(line), file) && std::strchr(line, '\n'))
+    {
+        complete_size = std::ftell(file);
+
+        uint64_t key;
+        int value;
+        if (std::sscanf(line, "%" SCNx64 " %d", &key, &value) != 2) continue;
+
+        solved[key] = static_cast<int8_t>(value);
+        ++count;
+    }
+
+    std::fseek(file, 0, SEEK_END);
+    bool truncated = std::ftell(file) != complete_size;
+
+    std::fclose(file);
+
+    if (truncated && ::truncate(path, complete_size) != 0) std::cerr << "Could not repair " << path << '\n';
+
+    return count;
+}
+
+int main(int argc, char *argv[])
+{
+    const char * out_path = nullptr;
+    std::string checkpoint_path;
+    const char * root_moves = "";
+    int max_ply = 8;
+    int num_workers = std::thread::hardware_concurrency();
+    size_t tt_size_mb = TT_DEFAULT_SIZE_MB;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--out") == 0 && i+1 < argc) out_path = argv[++i];
+        else if (std::strcmp(argv[i], "--ply") == 0 && i+1 < argc) max_ply = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--root") == 0 && i+1 < argc) root_moves = argv[++i];
+        else if (std::strcmp(argv[i], "--workers") == 0 && i+1 < argc) num_workers = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--checkpoint") == 0 && i+1 < argc) checkpoint_path = argv[++i];
+        else if (std::strcmp(argv[i], "--tt-size") == 0 && i+1 < argc) tt_size_mb = std::strtoull(argv[++i], nullptr, 10);
+    }
+
+    if (!out_path || max_ply < 0 || max_ply >= NUM_STONES)
+    {
+        std::cerr << "Usage: bookgen --out PATH [--ply N] [--root MOVES] [--workers N] [--checkpoint PATH] [--tt-size MB]\n";
+        return EXIT_FAILURE;
+    }
+
+    BookPosition root;
+    if (!parse_moves(root_moves, root.our_bb, root.their_bb) || check_win(root.their_bb))
+    {
+        std::cerr << "Invalid root " << root_moves << '\n';
+        return EXIT_FAILURE;
+    }
+    root.key = make_canonical_key(root.our_bb, root.their_bb);
+
+    if (tt_size_mb != TT_DEFAULT_SIZE_MB && !tt.resize(tt_size_mb))
+    {
+        std::cerr << "Could not allocate a " << tt_size_mb << "MB transposition table\n";
+        return EXIT_FAILURE;
+    }
+
+    if (checkpoint_path.empty()) checkpoint_path = std::string(out_path) + ".ckpt";
+    num_workers = std::max(1, num_workers);
+
+    std::vector<BookPosition> positions = enumerate_positions(root, max_ply);
+
+    std::unordered_map<TTKey, int8_t> solved;
+    size_t resumed = load_checkpoint(checkpoint_path.c_str(), solved);
+    if (resumed) std::cerr << "Resuming: " << resumed << " positions already solved\n";
+
+    // only what previous runs didn't solve
+    std::vector<BookPosition> todo;
+    for (const BookPosition & pos : positions)
+    {
+        if (!solved.count(pos.key)) todo.push_back(pos);
+    }
+
+    std::cerr << positions.size() << " positions, " << todo.size() << " left to solve with " << num_workers << " workers\n";
+
+    std::FILE * checkpoint = std::fopen(checkpoint_path.c_str(), "a");
+    if (!checkpoint)
+    {
+        std::cerr << "Could not open " << checkpoint_path << '\n';
+        return EXIT_FAILURE;
+    }
+
+    prepare_worker_search();
+
+    auto start = std::chrono::steady_clock::now();
+    std::atomic<size_t> next{0};
+    std::mutex checkpoint_mutex;
+    size_t num_solved = 0;
+    bool write_failed = false;
+
+    auto work = [&]()
+    {
+        for (size_t i = next++; i < todo.size(); i = next++)
+        {
+            const BookPosition & pos = todo[i];
+            int score = root_search(pos.our_bb, pos.their_bb, false);
+
+            std::lock_guard<std::mutex> lock(checkpoint_mutex);
+
+            solved[pos.key] = static_cast<int8_t>(score);
+            if (std::fprintf(checkpoint, "%" PRIx64 " %d\n", static_cast<uint64_t>(pos.key), score) < 0) write_failed = true;
+
+            if (++num_solved % BOOKGEN_CHECKPOINT_INTERVAL == 0 || num_solved == todo.size())
+            {
+                if (std::fflush(checkpoint) != 0) write_failed = true;
+
+                std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+                std::cerr << "solved " << num_solved << '/' << todo.size() << " (" << elapsed.count() << "s)\n";
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (int w = 1; w < num_workers; ++w)
+    {
+        workers.emplace_back(work);
+    }
+
+    work();
+
+    for (auto & worker : workers) worker.join();
+
+    // closing flushes, which may fail too
+    write_failed = (std::fclose(checkpoint) != 0) || write_failed;
+
+    if (write_failed)
+    {
+        // the book is still written, only resuming would redo some work
+        std::cerr << "Could not write to " << checkpoint_path << '\n';
+    }
+
+    std::vector<BookEntry> entries;
+    entries.reserve(solved.size());
+    for (const auto & [key, value] : solved)
+    {
+        entries.push_back(BookEntry{key, value});
+    }
+
+    if (!OpeningBook::write_sorted(out_path, entries))
+    {
+        std::cerr << "Could not write " << out_path << '\n';
+        return EXIT_FAILURE;
+    }
+
+    std::cerr << "Wrote " << entries.size() << " positions to " << out_path << '\n';
+
+    return EXIT_SUCCESS;
+}
@@ -1,15 +1,95 @@
 #pragma once
 
 #include <cstdint>
+#include <cstddef>
 
 constexpr auto NUM_STONES = 42; // 7x6 board
-constexpr auto IDS_START_DEPTH = 10; // start depth for iterative deepening
+constexpr int MAX_BOARD_STONES = 63; // of the largest board size the solver is built for (9x7), sizing search statistics
+constexpr int MAX_BOARD_WIDTH = 9;
 
 constexpr uint_fast64_t RNG_SEED = 1; // change if unsatisfactory
 
-constexpr size_t TT_STORAGE_BITS = 26; // 64M entries (~80MB)
-// Chinese remainder theorem states that 2^TT_STORAGE_BITS and TT_NUM_entries need to be coprime.
+constexpr size_t TT_DEFAULT_SIZE_MB = 128; // transposition table size unless resized (16M entries)
+constexpr size_t TT_BUCKET_BITS = 3; // 8 entries of 8 bytes per 64-byte bucket (one cache line), 4 if wide
+constexpr size_t TT_BUCKET_SLOTS = 1ULL << TT_BUCKET_BITS;
+// Position keys are below 2^KEY_BITS, KEY_BITS being the board's number of bits (49 on the standard board).
+// Chinese remainder theorem states that the bucket index and the TT_PARTIAL_KEY_BITS-bit partial key identify a key
+// if the number of buckets is coprime with 2^TT_PARTIAL_KEY_BITS and at least 2^(KEY_BITS-TT_PARTIAL_KEY_BITS):
+// the table uses a prime number of buckets above that (see BasicTranspositionTable::MIN_BUCKETS).
 // See < http://blog.gamesolver.org/solving-connect-four/11-optimized-transposition-table/ > for more details.
-constexpr size_t TT_NUM_ENTRIES = (1ULL << TT_STORAGE_BITS) + 1;
+constexpr int TT_PARTIAL_KEY_BITS = 32;
+constexpr size_t TT_MAX_BUCKETS = (1ULL << 32) - 1; // bucket indexes are computed exactly for fewer than 2^32 buckets
+constexpr uint64_t TT_WIDE_HASH_MULTIPLIER = 0x9E3779B97F4A7C15; // 2^64 / golden ratio, spreads the keys of wide entries (see tt.h)
+constexpr size_t TT_HUGE_PAGE_SIZE = 1ULL << 21; // the table is mapped in whole 2MB pages, aligned to them
 
-constexpr int8_t TT_NOT_FOUND = INT8_MIN; // used when value is not found
\ No newline at end of file
+constexpr int8_t TT_NOT_FOUND = INT8_MIN; // used when value is not found
+constexpr int TT_NO_MOVE = -1; // used when an entry holds no move
+constexpr int TT_NO_LOWER_BOUND = -64; // used when an entry holds no lower bound, below every score
+
+// Transposition table file format: a TT_FILE_HEADER_SIZE header, then the raw buckets.
+// Bump TT_FILE_VERSION whenever the entry layout or keying changes.
+constexpr uint32_t TT_FILE_MAGIC = 0x54543443; // "C4TT" in little-endian
+constexpr uint32_t TT_FILE_VERSION = 5;
+constexpr size_t TT_FILE_HEADER_SIZE = 4096; // one page, so the buckets can be mapped directly
+constexpr size_t TT_FILE_BLOCK_SIZE = 1ULL << 24; // 16MB per read/write call
+
+constexpr int DEFAULT_SEARCH_THREADS = 1; // threads used by root_search (lazy SMP when > 1)
+constexpr uint64_t BUDGET_CHECK_MASK = 4095; // budgeted searches check their budget every (BUDGET_CHECK_MASK+1) nodes
+constexpr int SMP_SHUFFLE_MASK = 3; // helper threads swap their first two moves at 1 node in (SMP_SHUFFLE_MASK+1)
+constexpr bool ETC_DEFAULT = true; // whether negamax uses enhanced transposition cutoffs unless told otherwise
+constexpr bool THREAT_ANALYSIS_DEFAULT = true; // whether negamax applies zugzwang rules unless told otherwise
+constexpr int SIMD_SORT_MIN_MOVES = 3; // sort_moves_with only uses vector code for at least this many moves
+
+constexpr size_t BATCH_CHUNK_SIZE = 4096; // positions read, solved and written together in batch mode
+constexpr size_t ANNOTATE_CHUNK_SIZE = 64; // games read, annotated and written together in annotation mode
+
+// Geometry check (see geometry_check.cpp).
+constexpr int GEOMETRY_CHECK_GAMES = 20000; // random games played on each board size
+constexpr int GEOMETRY_CHECK_SOLVES = 200; // random positions solved on each board size the solver is built for
+
+// Opening book file: a block of little-endian 32-bit partial keys followed by a block of 8-bit values
+// (see tools/little_endian.py). Each entry takes one key and one value.
+constexpr size_t BOOK_ENTRY_SIZE = sizeof(uint32_t) + sizeof(int8_t);
+
+// Sorted opening book file, written by bookgen: a BOOK_FILE_HEADER_SIZE header, then a block of sorted
+// little-endian 64-bit canonical keys followed by a block of 8-bit values.
+constexpr uint32_t BOOK_FILE_MAGIC = 0x4B423443; // "C4BK" in little-endian
+constexpr uint32_t BOOK_FILE_VERSION = 1;
+constexpr size_t BOOK_FILE_HEADER_SIZE = 16; // keeps the keys 8-byte aligned
+constexpr size_t BOOK_SORTED_ENTRY_SIZE = sizeof(uint64_t) + sizeof(int8_t);
+
+constexpr auto BOOK_DEFAULT_PATH = "opening_book_le.dat";
+
+// Position corpus file, written by corpusconv: a CORPUS_FILE_HEADER_SIZE header, then fixed-size records of
+// two little-endian 64-bit words (see corpus.h).
+constexpr uint32_t CORPUS_FILE_MAGIC = 0x43503443; // "C4PC" in little-endian
+constexpr uint32_t CORPUS_FILE_VERSION = 1;
+constexpr size_t CORPUS_FILE_HEADER_SIZE = 32; // keeps the records 16-byte aligned
+constexpr size_t CORPUS_RECORD_SIZE = 16;
+
+// Search trace file, written when tracing: a TRACE_FILE_HEADER_SIZE header, then fixed-size node records of
+// two little-endian 64-bit words (see trace.h).
+constexpr uint32_t TRACE_FILE_MAGIC = 0x52543443; // "C4TR" in little-endian
+constexpr uint32_t TRACE_FILE_VERSION = 1;
+constexpr size_t TRACE_FILE_HEADER_SIZE = 32; // keeps the records 16-byte aligned
+constexpr size_t TRACE_RECORD_SIZE = 16;
+
+constexpr size_t BOOKGEN_CHECKPOINT_INTERVAL = 64; // bookgen flushes its checkpoint every this many solved positions
+
+// Solver daemon (see daemon.h).
+constexpr int DAEMON_BACKLOG = 64; // connections waiting to be accepted by the daemon
+constexpr size_t DAEMON_MAX_CLIENTS = 256; // connections served at once by the daemon, more are closed right away
+constexpr size_t DAEMON_MAX_LINE = 256; // longest request line, longer ones close the connection
+
+// Distributed search (see distributed.h).
+constexpr int DISTRIBUTED_DEFAULT_SPLIT_PLY = 2; // moves from the root to the subproblems handed to worker processes
+constexpr int DISTRIBUTED_MAX_ATTEMPTS = 3; // workers a subproblem may crash before the search gives up on it
+
+// Perft tool (see perft.cpp).
+constexpr int PERFT_SPLIT_PLY = 2; // moves from the root to the subtrees handed to perft's threads
+
+// Search tracing (see trace.h).
+constexpr size_t TRACE_RING_SIZE = 1 << 16; // records buffered per search thread, a power of 2; more are dropped
+constexpr int TRACE_FLUSH_INTERVAL_MS = 10; // the trace writer drains the buffers this often
+constexpr int TRACE_DEFAULT_MIN_DEPTH = 20; // nodes with at least this many empty squares are always traced
+constexpr int TRACE_DEFAULT_SAMPLE_LOG2 = 12; // 1 in 2^this of the other nodes are traced, -1 for none
@@ -0,0 +1,88 @@
+#include "corpus.h"
+
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "the corpus file is little-endian");
+
+bool Corpus::open(const char * path)
+{
+    close();
+
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < CORPUS_FILE_HEADER_SIZE)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    size_t map_size = static_cast<size_t>(st.st_size);
+    void * map = mmap(nullptr, map_size, PROT_READ, MAP_SHARED, fd, 0);
+
+    // the mapping stays valid after the descriptor is closed
+    ::close(fd);
+
+    if (map == MAP_FAILED) return false;
+
+    CorpusHeader header;
+    std::memcpy(&header, map, sizeof(header));
+
+    size_t data_size = map_size - CORPUS_FILE_HEADER_SIZE;
+
+    if (header.magic != CORPUS_FILE_MAGIC || header.version != CORPUS_FILE_VERSION
+        || header.record_size != CORPUS_RECORD_SIZE || header.num_stones != NUM_STONES
+        || data_size % CORPUS_RECORD_SIZE != 0 || data_size / CORPUS_RECORD_SIZE != header.num_records)
+    {
+        munmap(map, map_size);
+        return false;
+    }
+
+    // records are mostly read in order
+    madvise(map, map_size, MADV_SEQUENTIAL);
+
+    m_map = map;
+    m_map_size = map_size;
+    m_num_records = header.num_records;
+    m_records = reinterpret_cast<const CorpusRecord *>(static_cast<const char *>(map) + CORPUS_FILE_HEADER_SIZE);
+
+    return true;
+}
+
+void Corpus::close()
+{
+    if (m_map) munmap(m_map, m_map_size);
+
+    m_map = nullptr;
+    m_map_size = 0;
+    m_num_records = 0;
+    m_records = nullptr;
+}
+
+bool CorpusWriter::open(const char * path)
+{
+    m_num_records = 0;
+
+    return m_file.open(path, CORPUS_FILE_HEADER_SIZE);
+}
+
+bool CorpusWriter::add(const CorpusRecord & record)
+{
+    if (!m_file.write(&record, sizeof(record))) return false;
+
+    ++m_num_records;
+    return true;
+}
+
+bool CorpusWriter::close()
+{
+    CorpusHeader header{CORPUS_FILE_MAGIC, CORPUS_FILE_VERSION, CORPUS_RECORD_SIZE, NUM_STONES, m_num_records, 0};
+
+    return m_file.close(&header, sizeof(header));
+}
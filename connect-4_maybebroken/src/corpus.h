@@ -0,0 +1,143 @@
+#pragma once
+
+#include "bitboard.h"
+
+#include "constants.h"
+#include "headered_file.h"
+
+#include <cstdint>
+
+
+// Record layout: each word holds a bitboard in bits 0-55, and a byte in bits 56-63:
+// the score (int8) for our pieces' word, the flags for our opponent's.
+constexpr int CORPUS_BYTE_SHIFT = 56;
+constexpr uint64_t CORPUS_BOARD_MASK = (1ULL << CORPUS_BYTE_SHIFT) - 1;
+static_assert(StandardGeometry::NUM_BITS <= CORPUS_BYTE_SHIFT, "bitboards must fit below the record's byte");
+
+// Record flags.
+constexpr uint8_t CORPUS_FLAG_SCORED = 1; // the record holds the position's score
+
+/// @brief A position of a corpus file, used in place in the mapping: 16 little-endian bytes, no parsing needed.
+struct CorpusRecord
+{
+    uint64_t our_word; // the pieces of the side to move, and the score
+    uint64_t their_word; // our opponent's pieces, and the flags
+
+    /// @brief Build a record.
+    /// @param our_bb Our pieces (the side to move).
+    /// @param their_bb Our opponent's pieces.
+    /// @param scored Whether the score is known.
+    /// @param score The position's score, as returned by root_search. Ignored unless scored.
+    static CorpusRecord make(Bitboard our_bb, Bitboard their_bb, bool scored = false, int score = 0)
+    {
+        uint64_t score_byte = scored ? static_cast<uint8_t>(score) : 0;
+        uint64_t flags = scored ? CORPUS_FLAG_SCORED : 0;
+        return CorpusRecord{our_bb | (score_byte << CORPUS_BYTE_SHIFT), their_bb | (flags << CORPUS_BYTE_SHIFT)};
+    }
+
+    /// @brief Get our pieces.
+    Bitboard our() const { return our_word & CORPUS_BOARD_MASK; }
+
+    /// @brief Get our opponent's pieces.
+    Bitboard their() const { return their_word & CORPUS_BOARD_MASK; }
+
+    /// @brief Get the flags, a combination of CORPUS_FLAG_*.
+    uint8_t flags() const { return their_word >> CORPUS_BYTE_SHIFT; }
+
+    /// @brief Check whether the record holds the position's score.
+    bool has_score() const { return flags() & CORPUS_FLAG_SCORED; }
+
+    /// @brief Get the position's score, as returned by root_search. Only meaningful if has_score.
+    int score() const { return static_cast<int8_t>(our_word >> CORPUS_BYTE_SHIFT); }
+};
+
+static_assert(sizeof(CorpusRecord) == CORPUS_RECORD_SIZE, "records must be packed");
+
+/// @brief Header of a corpus file, padded to CORPUS_FILE_HEADER_SIZE bytes.
+struct CorpusHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t num_stones; // of the board geometry the bitboards are laid out for
+    uint64_t num_records;
+    uint64_t reserved; // zero, so that the header has no padding
+};
+
+static_assert(sizeof(CorpusHeader) <= CORPUS_FILE_HEADER_SIZE, "header must fit its padded block");
+
+/// @brief A read-only position corpus, memory-mapped from a file written by CorpusWriter (see corpusconv).
+/// Records are neither copied nor checked: they are what the writer was given.
+class Corpus
+{
+public:
+    Corpus() = default;
+
+    /// @brief NO COPY CONSTRUCTOR ALLOWED
+    Corpus(const Corpus&) = delete;
+
+    ~Corpus()
+    {
+        close();
+    }
+
+    /// @brief Map a corpus file into memory. No data is copied; pages are loaded on demand, read ahead
+    /// for iteration in order. Any previously opened corpus is closed first.
+    /// Files from another format version or board geometry, or whose size doesn't match their header, are rejected.
+    /// @param path The corpus file's path.
+    /// @return Whether the corpus was opened successfully.
+    bool open(const char * path);
+
+    /// @brief Unmap the corpus, if any.
+    void close();
+
+    /// @brief Check whether a corpus is currently mapped.
+    bool is_open() const { return m_map != nullptr; }
+
+    /// @brief Get the number of records, 0 if no corpus is mapped.
+    size_t size() const { return m_num_records; }
+
+    /// @brief Get a record.
+    /// @param index The record's index, below size().
+    const CorpusRecord & operator[](size_t index) const { return m_records[index]; }
+
+    /// @brief Iterate over the records.
+    const CorpusRecord * begin() const { return m_records; }
+    const CorpusRecord * end() const { return m_records + m_num_records; }
+
+private:
+    void * m_map = nullptr; // the whole mapped file
+    size_t m_map_size = 0; // size of the mapping, in bytes
+    size_t m_num_records = 0;
+    const CorpusRecord * m_records = nullptr; // points into the mapping, right after the header
+};
+
+/// @brief Writes a corpus file one record at a time, so that corpora larger than memory can be written.
+class CorpusWriter
+{
+public:
+    CorpusWriter() = default;
+
+    /// @brief NO COPY CONSTRUCTOR ALLOWED
+    CorpusWriter(const CorpusWriter&) = delete;
+
+    /// @brief Start writing a corpus file. Any file being written is abandoned first.
+    /// @param path The file's path, replaced only once the whole file is written (by close).
+    /// @return Whether the file could be created.
+    bool open(const char * path);
+
+    /// @brief Append a record.
+    /// @return Whether it was written (or buffered) successfully.
+    bool add(const CorpusRecord & record);
+
+    /// @brief Finish the file: write its header and move it to its path.
+    /// @return Whether the whole file was written successfully. If not, nothing is left at its path.
+    bool close();
+
+    /// @brief Get the number of records added so far.
+    size_t size() const { return m_num_records; }
+
+private:
+    HeaderedFileWriter m_file; // abandoned if not closed
+    size_t m_num_records = 0;
+};
@@ -0,0 +1,234 @@
+// Corpus converter: writes text positions into a binary corpus file (see corpus.h), or dumps one back as text.
+//
+// Usage: corpusconv --out FILE [text files...]
+//        corpusconv --dump FILE
+// Without text files, positions are read from stdin ("-" also means stdin). Each position is either:
+// - one line: a move string or two comma-separated bitboards (side to move first, see parse_position),
+//   optionally followed by the position's score;
+// - a grid: 6 lines of 7 cells drawn from the top rank down, '.' or 'e' for an empty cell, 'x' or 'a' for
+//   the first player's stones and 'o' or 'b' for the second player's (upper case too), the last line
+//   optionally followed by the score. The side to move follows from the stone counts.
+// Empty lines and lines starting with '#' are skipped. Lines which aren't valid positions are reported and skipped,
+// and make the exit status non-zero.
+// Dumps print one "our,their score" line per record, in the converter's input format (without score if unscored).
+
+#include "corpus.h"
+#include "notation.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+
+/// @brief Read a cell of a grid.
+/// @return 0 for an empty cell, 1 for the first player's stone, 2 for the second player's, -1 if not a cell.
+static int grid_cell(char c)
+{
+    switch (c)
+    {
+        case '.': case 'e': case 'E': return 0;
+        case 'x': case 'X': case 'a': case 'A': return 1;
+        case 'o': case 'O': case 'b': case 'B': return 2;
+        default: return -1;
+    }
+}
+
+/// @brief Check whether a token is a row of a grid.
+static bool is_grid_row(const std::string & token)
+{
+    if (token.size() != 7) return false;
+    for (char c : token) if (grid_cell(c) < 0) return false;
+    return true;
+}
+
+/// @brief Read an optional score after a position.
+/// @param fields The rest of the line.
+/// @param scored Receives whether there was a score.
+/// @param score Receives the score.
+/// @return Whether the rest of the line is empty or a score within the scale of root_search.
+static bool read_score(std::istringstream & fields, bool & scored, int & score)
+{
+    scored = static_cast<bool>(fields >> score);
+    if (!scored) return fields.eof();
+
+    std::string extra;
+    return !(fields >> extra) && score >= -NUM_STONES && score <= NUM_STONES + 1;
+}
+
+/// @brief Convert the positions of a text stream.
+/// @param in The text.
+/// @param name The stream's name, for error messages.
+/// @param writer Receives the positions.
+/// @return The number of lines which aren't valid positions.
+static size_t convert(std::istream & in, const std::string & name, CorpusWriter & writer)
+{
+    size_t num_errors = 0;
+    size_t line_number = 0;
+    std::string line;
+
+    while (std::getline(in, line))
+    {
+        ++line_number;
+
+        // tolerate CRLF input
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty() || line[0] == '#') continue;
+
+        std::istringstream fields(line);
+        std::string token;
+        fields >> token;
+
+        Bitboard our_bb, their_bb;
+        bool scored = false;
+        int score = 0;
+        bool ok;
+
+        if (is_grid_row(token))
+        {
+            // the first player's stones, then the second player's
+            Bitboard stones[3] = {Empty_BB, Empty_BB, Empty_BB};
+            size_t first_line = line_number;
+
+            ok = true;
+            for (int rank = 5; ; --rank)
+            {
+                for (int file = 0; file < 7; ++file) stones[grid_cell(token[file])] |= square_bb(file, rank);
+
+                if (rank == 0) break;
+
+                // only the bottom row may be followed by the score
+                ok = (fields >> std::ws).eof() && std::getline(in, line);
+                if (!ok) break;
+                ++line_number;
+
+                if (!line.empty() && line.back() == '\r') line.pop_back();
+                fields = std::istringstream(line);
+                ok = (fields >> token) && is_grid_row(token);
+                if (!ok) break;
+            }
+
+            // the first player moves when both have played as many stones
+            bool first_to_move = popcount(stones[1]) == popcount(stones[2]);
+            our_bb = first_to_move ? stones[1] : stones[2];
+            their_bb = first_to_move ? stones[2] : stones[1];
+
+            ok = ok && read_score(fields, scored, score) && valid_position(our_bb, their_bb);
+            if (!ok)
+            {
+                std::cerr << name << ':' << first_line << ": bad grid\n";
+                ++num_errors;
+            }
+        }
+        else
+        {
+            ok = parse_position(token, our_bb, their_bb) && read_score(fields, scored, score);
+            if (!ok)
+            {
+                std::cerr << name << ':' << line_number << ": bad line \"" << line << "\"\n";
+                ++num_errors;
+            }
+        }
+
+        if (ok) writer.add(CorpusRecord::make(our_bb, their_bb, scored, score));
+    }
+
+    return num_errors;
+}
+
+/// @brief Print a corpus in the converter's input format.
+/// @return Whether the corpus could be opened.
+static bool dump(const char * path)
+{
+    Corpus corpus;
+    if (!corpus.open(path)) return false;
+
+    std::string buffer;
+    for (const CorpusRecord & record : corpus)
+    {
+        buffer += std::to_string(record.our()) + ',' + std::to_string(record.their());
+        if (record.has_score()) buffer += ' ' + std::to_string(record.score());
+        buffer += '\n';
+
+        if (buffer.size() >= (1 << 16))
+        {
+            std::cout.write(buffer.data(), buffer.size());
+            buffer.clear();
+        }
+    }
+    std::cout.write(buffer.data(), buffer.size());
+
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    const char * out_path = nullptr;
+    const char * dump_path = nullptr;
+    std::vector<std::string> paths;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--out") == 0 && i+1 < argc) out_path = argv[++i];
+        else if (std::strcmp(argv[i], "--dump") == 0 && i+1 < argc) dump_path = argv[++i];
+        else paths.push_back(argv[i]);
+    }
+
+    std::ios::sync_with_stdio(false);
+
+    if (dump_path)
+    {
+        if (dump(dump_path)) return EXIT_SUCCESS;
+
+        std::cerr << "Could not open corpus " << dump_path << '\n';
+        return EXIT_FAILURE;
+    }
+
+    if (!out_path)
+    {
+        std::cerr << "Usage: corpusconv --out FILE [text files...] | corpusconv --dump FILE\n";
+        return EXIT_FAILURE;
+    }
+
+    CorpusWriter writer;
+    if (!writer.open(out_path))
+    {
+        std::cerr << "Could not create " << out_path << '\n';
+        return EXIT_FAILURE;
+    }
+
+    if (paths.empty()) paths.push_back("-");
+
+    size_t num_errors = 0;
+    for (const std::string & path : paths)
+    {
+        if (path == "-")
+        {
+            num_errors += convert(std::cin, "stdin", writer);
+            continue;
+        }
+
+        std::ifstream file(path);
+        if (!file)
+        {
+            std::cerr << "Could not open " << path << '\n';
+            return EXIT_FAILURE;
+        }
+
+        num_errors += convert(file, path, writer);
+    }
+
+    size_t num_records = writer.size();
+    if (!writer.close())
+    {
+        std::cerr << "Could not write " << out_path << '\n';
+        return EXIT_FAILURE;
+    }
+
+    std::cerr << num_records << " positions written to " << out_path << ", " << num_errors << " bad\n";
+
+    return num_errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
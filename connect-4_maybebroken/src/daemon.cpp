@@ -0,0 +1,363 @@
+#include "daemon.h"
+
+#include "constants.h"
+#include "notation.h"
+#include "search.h"
+#include "tt.h"
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <csignal>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+
+using Clock = std::chrono::steady_clock;
+
+/// @brief A request line waiting for its answer.
+struct Request
+{
+    std::string line;
+    Clock::time_point received;
+};
+
+/// @brief A request handed to a worker.
+struct Job
+{
+    int fd; // the connection to answer on
+    Request request;
+};
+
+/// @brief A client connection, owned by the polling thread.
+struct Connection
+{
+    std::string buffer; // bytes read after the last complete line
+    std::deque<Request> pending; // complete lines not handed to a worker yet
+    bool busy = false; // whether a worker is answering one of its requests
+    bool closing = false; // whether the client closed its side, or broke the protocol
+};
+
+// Written to by signal handlers and workers, read by the polling thread: a connection's fd once its request
+// is answered, or DAEMON_STOP.
+static int wake_pipe[2] = {-1, -1};
+constexpr int DAEMON_STOP = -1;
+
+/// @brief Ask the polling thread to stop, from a signal handler.
+static void handle_stop_signal(int)
+{
+    int message = DAEMON_STOP;
+    [[maybe_unused]] ssize_t written = write(wake_pipe[1], &message, sizeof(message));
+}
+
+/// @brief Send a whole buffer, whatever the client does with its socket.
+/// @return Whether everything was sent.
+static bool send_all(int fd, const std::string & data)
+{
+    size_t sent = 0;
+    while (sent < data.size())
+    {
+        // no SIGPIPE if the client went away
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        sent += n;
+    }
+    return true;
+}
+
+/// @brief State shared by the polling thread and the workers.
+class Daemon
+{
+public:
+    /// @brief Answer requests until stop is called.
+    void work()
+    {
+        while (true)
+        {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(m_jobs_mutex);
+                m_jobs_cv.wait(lock, [this]() { return m_stopping || !m_jobs.empty(); });
+                if (m_stopping) return;
+
+                job = std::move(m_jobs.front());
+                m_jobs.pop_front();
+            }
+
+            // a failed send means the client is gone, the polling thread finds out by itself
+            send_all(job.fd, answer(job.request));
+
+            int message = job.fd;
+            [[maybe_unused]] ssize_t written = write(wake_pipe[1], &message, sizeof(message));
+        }
+    }
+
+    /// @brief Hand a request to the workers.
+    void submit(int fd, Request request)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_jobs_mutex);
+            m_jobs.push_back(Job{fd, std::move(request)});
+        }
+        m_jobs_cv.notify_one();
+    }
+
+    /// @brief Make the workers return once their current request is answered.
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_jobs_mutex);
+            m_stopping = true;
+        }
+        m_jobs_cv.notify_all();
+    }
+
+private:
+    /// @brief Compute the answer line to a request.
+    std::string answer(const Request & request)
+    {
+        if (request.line == "stats")
+        {
+            std::lock_guard<std::mutex> lock(m_stats_mutex);
+            long long mean = m_num_requests ? m_total_latency_us / static_cast<long long>(m_num_requests) : 0;
+            return std::to_string(m_num_requests) + ',' + std::to_string(mean) + ',' + std::to_string(m_max_latency_us) + '\n';
+        }
+
+        if (request.line == "clear")
+        {
+            // the table must not be cleared under a search
+            std::unique_lock<std::shared_mutex> lock(m_tt_mutex);
+            tt.clear();
+            return "ok\n";
+        }
+
+        Bitboard our_bb, their_bb;
+        if (!parse_position(request.line, our_bb, their_bb)) return "invalid\n";
+
+        auto start = Clock::now();
+        reset_search_stats();
+
+        Bitboard best_move;
+        int score;
+        {
+            std::shared_lock<std::shared_mutex> lock(m_tt_mutex);
+            score = find_best_move(our_bb, their_bb, best_move, false);
+        }
+
+        auto end = Clock::now();
+        long long time_us = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+        long long latency_us = std::chrono::duration_cast<std::chrono::microseconds>(end - request.received).count();
+
+        {
+            std::lock_guard<std::mutex> lock(m_stats_mutex);
+            ++m_num_requests;
+            m_total_latency_us += latency_us;
+            m_max_latency_us = std::max(m_max_latency_us, latency_us);
+        }
+
+        return std::to_string(score) + ',' + std::to_string(move_column(best_move)) + ','
+             + std::to_string(search_stats().nodes) + ',' + std::to_string(time_us) + ',' + std::to_string(latency_us) + '\n';
+    }
+
+    std::mutex m_jobs_mutex;
+    std::condition_variable m_jobs_cv;
+    std::deque<Job> m_jobs;
+    bool m_stopping = false;
+
+    std::shared_mutex m_tt_mutex; // held shared by searches, exclusively by clear
+
+    std::mutex m_stats_mutex;
+    uint64_t m_num_requests = 0;
+    long long m_total_latency_us = 0;
+    long long m_max_latency_us = 0;
+};
+
+/// @brief Create the listening socket.
+/// @return The socket, -1 on error.
+static int open_socket(const char * socket_path)
+{
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (std::strlen(socket_path) >= sizeof(addr.sun_path)) return -1;
+    std::strcpy(addr.sun_path, socket_path);
+
+    // only replace a socket, never another kind of file
+    struct stat st;
+    if (stat(socket_path, &st) == 0)
+    {
+        if (!S_ISSOCK(st.st_mode)) return -1;
+        unlink(socket_path);
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+
+    if (bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 || listen(fd, DAEMON_BACKLOG) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/// @brief Read what a client sent, splitting it into requests.
+static void read_client(int fd, Connection & conn)
+{
+    char data[4096];
+    ssize_t n = read(fd, data, sizeof(data));
+
+    if (n <= 0)
+    {
+        // closed (or broken) on the client's side: answer what was already sent, then close
+        if (n == 0 || errno != EINTR) conn.closing = true;
+        return;
+    }
+
+    auto now = Clock::now();
+    conn.buffer.append(data, n);
+
+    size_t begin = 0;
+    for (size_t end; (end = conn.buffer.find('\n', begin)) != std::string::npos; begin = end + 1)
+    {
+        std::string line = conn.buffer.substr(begin, end - begin);
+
+        // tolerate CRLF input and blank lines
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (!line.empty()) conn.pending.push_back(Request{line, now});
+    }
+    conn.buffer.erase(0, begin);
+
+    // not a client of ours
+    if (conn.buffer.size() > DAEMON_MAX_LINE) conn.closing = true;
+}
+
+bool run_daemon(const char * socket_path, int num_workers)
+{
+    num_workers = std::max(1, num_workers);
+
+    int listen_fd = open_socket(socket_path);
+    if (listen_fd < 0) return false;
+
+    if (pipe(wake_pipe) != 0)
+    {
+        close(listen_fd);
+        return false;
+    }
+
+    prepare_worker_search();
+
+    std::signal(SIGINT, handle_stop_signal);
+    std::signal(SIGTERM, handle_stop_signal);
+
+    Daemon daemon;
+    std::vector<std::thread> workers;
+    for (int w = 0; w < num_workers; ++w)
+    {
+        workers.emplace_back(&Daemon::work, &daemon);
+    }
+
+    std::cerr << "Listening on " << socket_path << " with " << num_workers << " workers\n";
+
+    std::map<int, Connection> connections;
+    std::vector<pollfd> fds;
+    bool running = true;
+
+    while (running)
+    {
+        // closing connections are done reading, they only wait for their last answers
+        fds.clear();
+        fds.push_back(pollfd{wake_pipe[0], POLLIN, 0});
+        fds.push_back(pollfd{listen_fd, POLLIN, 0});
+        for (const auto & [fd, conn] : connections)
+        {
+            if (!conn.closing) fds.push_back(pollfd{fd, POLLIN, 0});
+        }
+
+        if (poll(fds.data(), fds.size(), -1) < 0)
+        {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        if (fds[0].revents & POLLIN)
+        {
+            int message;
+            if (read(wake_pipe[0], &message, sizeof(message)) == sizeof(message))
+            {
+                if (message == DAEMON_STOP) running = false;
+                else if (connections.count(message)) connections[message].busy = false;
+            }
+        }
+
+        if (fds[1].revents & POLLIN)
+        {
+            int client = accept(listen_fd, nullptr, nullptr);
+            if (client >= 0)
+            {
+                if (connections.size() < DAEMON_MAX_CLIENTS) connections[client];
+                else close(client);
+            }
+        }
+
+        for (size_t i = 2; i < fds.size(); ++i)
+        {
+            if (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) read_client(fds[i].fd, connections[fds[i].fd]);
+        }
+
+        // hand out the next request of each idle connection (one at a time, so that answers stay in order),
+        // close the finished ones
+        for (auto it = connections.begin(); it != connections.end(); )
+        {
+            Connection & conn = it->second;
+
+            if (!conn.busy && !conn.pending.empty())
+            {
+                conn.busy = true;
+                daemon.submit(it->first, std::move(conn.pending.front()));
+                conn.pending.pop_front();
+            }
+
+            if (conn.closing && !conn.busy && conn.pending.empty())
+            {
+                close(it->first);
+                it = connections.erase(it);
+            }
+            else ++it;
+        }
+    }
+
+    std::cerr << "Stopping\n";
+
+    // searches in progress are finished first
+    daemon.stop();
+    for (auto & worker : workers) worker.join();
+
+    for (const auto & [fd, conn] : connections) close(fd);
+    close(listen_fd);
+    unlink(socket_path);
+
+    close(wake_pipe[0]);
+    close(wake_pipe[1]);
+
+    std::signal(SIGINT, SIG_DFL);
+    std::signal(SIGTERM, SIG_DFL);
+
+    return true;
+}
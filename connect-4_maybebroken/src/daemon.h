@@ -0,0 +1,19 @@
+#pragma once
+
+
+/// @brief Serve positions over a Unix domain socket until SIGINT or SIGTERM, keeping the transposition table warm
+/// across requests: its entries stay valid whatever was searched before, so it is only cleared when a client asks.
+///
+/// The protocol is line based. Each request line is answered by one line, in order on each connection:
+/// - a position (see parse_position) -> "score,best_move,nodes,time_us,latency_us", the best move as a column 1-7
+///   (0 if there is none), time_us the time spent solving and latency_us the time since the request was read,
+///   waiting for a worker included; "invalid" if the position could not be parsed;
+/// - "stats" -> "requests,mean_latency_us,max_latency_us" over all requests answered so far;
+/// - "clear" -> "ok" once the transposition table is cleared, after the searches in progress finish.
+///
+/// Connections are served by one thread, which hands complete lines to a fixed pool of workers
+/// (one request of each connection at a time). Each worker searches on a single thread; search progress output is turned off.
+/// @param socket_path The socket's path. A stale socket left there by a previous run is replaced.
+/// @param num_workers The number of worker threads, at least 1.
+/// @return Whether the daemon ran and stopped cleanly, false if the socket could not be set up.
+bool run_daemon(const char * socket_path, int num_workers);
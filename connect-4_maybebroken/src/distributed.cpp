@@ -0,0 +1,460 @@
+#include "distributed.h"
+
+#include "constants.h"
+#include "search_helpers.h"
+#include "tt.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+
+/// @brief A position of the tree expanded by the coordinator, from the root to the split ply.
+struct TopNode
+{
+    Bitboard our_bb;
+    Bitboard their_bb;
+    Bitboard move; // square played by the parent to get here
+    int min; // proven lower bound of the score
+    int max; // proven upper bound of the score
+    int subproblem; // index of the subproblem solving it at the split ply, -1 elsewhere
+    std::vector<int> children; // indices in the tree, best moves first; none if the score was exact from the start
+};
+
+/// @brief A position at the split ply, solved by workers.
+struct Subproblem
+{
+    Bitboard our_bb;
+    Bitboard their_bb;
+    int min; // proven lower bound of the score
+    int max; // proven upper bound of the score
+    bool needed = false; // whether its score may still change the root's score
+    int alpha = 0; // the window where it may, when needed
+    int beta = 0;
+    bool running = false;
+    bool searched = false; // whether a worker answered for it
+    int attempts = 0; // times handed to a worker in a row without an answer
+};
+
+/// @brief What the coordinator sends a worker: a position, and the window where its score matters.
+struct WorkerJob
+{
+    Bitboard our_bb;
+    Bitboard their_bb;
+    int alpha;
+    int beta;
+};
+
+/// @brief A worker process, with the pipes it reads jobs from and writes replies to.
+struct Worker
+{
+    pid_t pid = -1; // -1 when not started
+    int job_fd = -1;
+    int reply_fd = -1;
+    int subproblem = -1; // index of the subproblem being solved, -1 when idle
+};
+
+/// @brief What a worker sends back for a job.
+struct WorkerReply
+{
+    int min;
+    int max;
+    uint64_t nodes;
+};
+
+// bounds wider than any score, for the root's window
+constexpr int SCORE_INFINITY = NUM_STONES + 2;
+
+/// @brief Read a whole buffer from a pipe.
+/// @return Whether everything was read, false once the other end is closed.
+static bool read_all(int fd, void * data, size_t size)
+{
+    char * bytes = static_cast<char *>(data);
+    while (size)
+    {
+        ssize_t n = read(fd, bytes, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        bytes += n;
+        size -= n;
+    }
+    return true;
+}
+
+/// @brief Write a whole buffer to a pipe.
+/// @return Whether everything was written, false once the other end is closed.
+static bool write_all(int fd, const void * data, size_t size)
+{
+    const char * bytes = static_cast<const char *>(data);
+    while (size)
+    {
+        ssize_t n = write(fd, bytes, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        bytes += n;
+        size -= n;
+    }
+    return true;
+}
+
+/// @brief Expand the tree from a position down to the split ply.
+/// @param ply_left The number of moves left to the split ply.
+/// @param keys The index of each subproblem by canonical key, so that transpositions are solved once.
+/// @return The position's index in the tree.
+static int build_tree(std::vector<TopNode> & tree, std::vector<Subproblem> & subproblems,
+                      std::unordered_map<TTKey, int> & keys, Bitboard our_bb, Bitboard their_bb, Bitboard move, int ply_left)
+{
+    int index = tree.size();
+    int depth_left = NUM_STONES - popcount(our_bb|their_bb);
+    tree.push_back(TopNode{our_bb, their_bb, move, 0, 0, -1, {}});
+
+    // same scale as negamax: the game ends here or next move
+    Bitboard possible = possible_moves(our_bb, their_bb);
+    if (possible == Empty_BB) return index; // draw
+
+    if (winning_positions(our_bb, their_bb) & possible)
+    {
+        tree[index].min = tree[index].max = depth_left + 1;
+        return index;
+    }
+
+    Bitboard non_losing = possible_non_losing_moves(our_bb, their_bb);
+    if (non_losing == Empty_BB)
+    {
+        tree[index].min = tree[index].max = -depth_left;
+        return index;
+    }
+
+    // we can't win next, and have a move which doesn't lose next
+    tree[index].min = -depth_left;
+    tree[index].max = depth_left - 1;
+
+    if (ply_left == 0)
+    {
+        auto [it, added] = keys.try_emplace(make_canonical_key(our_bb, their_bb), subproblems.size());
+        if (added) subproblems.push_back(Subproblem{our_bb, their_bb, tree[index].min, tree[index].max});
+        tree[index].subproblem = it->second;
+        return index;
+    }
+
+    // best moves first: their subproblems are queued first, and are the likeliest to make the others useless
+    auto [sorted, num_moves] = sort_moves(our_bb, their_bb, non_losing);
+    for (int i = 0; i < num_moves; ++i)
+    {
+        int child = build_tree(tree, subproblems, keys, their_bb, sorted[i].move, sorted[i].move ^ our_bb, ply_left - 1);
+        tree[index].children.push_back(child);
+    }
+
+    return index;
+}
+
+/// @brief Compute the bounds of a position from the subproblems solved so far, with negamax.
+static void update_bounds(std::vector<TopNode> & tree, const std::vector<Subproblem> & subproblems, int index)
+{
+    TopNode & node = tree[index];
+
+    if (node.subproblem >= 0)
+    {
+        node.min = subproblems[node.subproblem].min;
+        node.max = subproblems[node.subproblem].max;
+        return;
+    }
+
+    if (node.children.empty()) return;
+
+    int min = INT_MIN;
+    int max = INT_MIN;
+    for (int child : node.children)
+    {
+        update_bounds(tree, subproblems, child);
+        min = std::max(min, -tree[child].max);
+        max = std::max(max, -tree[child].min);
+    }
+
+    node.min = min;
+    node.max = max;
+}
+
+/// @brief Flag the subproblems under a position whose scores may still change its score within ]alpha; beta[.
+static void mark_needed(const std::vector<TopNode> & tree, std::vector<Subproblem> & subproblems, int index, int alpha, int beta)
+{
+    const TopNode & node = tree[index];
+
+    // exact, or known to be outside the window
+    if (node.min == node.max || node.max <= alpha || node.min >= beta) return;
+
+    if (node.subproblem >= 0)
+    {
+        // transpositions may need it in different windows
+        Subproblem & sub = subproblems[node.subproblem];
+        sub.alpha = sub.needed ? std::min(sub.alpha, alpha) : alpha;
+        sub.beta = sub.needed ? std::max(sub.beta, beta) : beta;
+        sub.needed = true;
+        return;
+    }
+
+    for (int child : node.children)
+    {
+        // the score a sibling already guarantees
+        int guaranteed = alpha;
+        for (int other : node.children)
+        {
+            if (other != child) guaranteed = std::max(guaranteed, -tree[other].max);
+        }
+
+        // this move can't do better than that
+        if (-tree[child].min <= guaranteed) continue;
+
+        mark_needed(tree, subproblems, child, -beta, -guaranteed);
+    }
+}
+
+/// @brief Body of a worker process: solve the positions read from a pipe until it is closed.
+static void run_worker(int job_fd, int reply_fd)
+{
+    set_search_verbose(false);
+
+    WorkerJob job;
+    while (read_all(job_fd, &job, sizeof(job)))
+    {
+        reset_search_stats();
+
+        SearchResult result = root_search_window(job.our_bb, job.their_bb, job.alpha, job.beta);
+        WorkerReply reply{result.min, result.max, search_stats().nodes};
+
+        if (!write_all(reply_fd, &reply, sizeof(reply))) return;
+    }
+}
+
+/// @brief Fork a worker process.
+/// @param worker Receives the process and its pipes.
+/// @param workers All workers, whose pipes the new process must not keep open.
+/// @return Whether the worker was started.
+static bool start_worker(Worker & worker, const std::vector<Worker> & workers)
+{
+    int job_pipe[2];
+    int reply_pipe[2];
+    if (pipe(job_pipe) != 0) return false;
+    if (pipe(reply_pipe) != 0)
+    {
+        close(job_pipe[0]);
+        close(job_pipe[1]);
+        return false;
+    }
+
+    // nothing buffered may be written twice
+    std::cout.flush();
+    std::cerr.flush();
+
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        close(job_pipe[0]);
+        close(job_pipe[1]);
+        close(reply_pipe[0]);
+        close(reply_pipe[1]);
+        return false;
+    }
+
+    if (pid == 0)
+    {
+        // another worker's pipe left open here would hide its end from the coordinator
+        for (const Worker & other : workers)
+        {
+            if (other.pid < 0) continue;
+            close(other.job_fd);
+            close(other.reply_fd);
+        }
+        close(job_pipe[1]);
+        close(reply_pipe[0]);
+
+        run_worker(job_pipe[0], reply_pipe[1]);
+
+        // skip the coordinator's destructors and buffered output
+        _exit(EXIT_SUCCESS);
+    }
+
+    close(job_pipe[0]);
+    close(reply_pipe[1]);
+
+    worker.pid = pid;
+    worker.job_fd = job_pipe[1];
+    worker.reply_fd = reply_pipe[0];
+    worker.subproblem = -1;
+    return true;
+}
+
+/// @brief Close a worker's pipes and wait for it to exit.
+/// @param kill_it Whether to kill it rather than let it finish its job.
+static void stop_worker(Worker & worker, bool kill_it)
+{
+    if (kill_it) kill(worker.pid, SIGKILL);
+
+    close(worker.job_fd);
+    close(worker.reply_fd);
+    while (waitpid(worker.pid, nullptr, 0) < 0 && errno == EINTR) {}
+
+    worker = Worker{};
+}
+
+DistributedSummary distributed_search(Bitboard our_bb, Bitboard their_bb, int split_ply, int num_processes)
+{
+    num_processes = std::max(1, num_processes);
+    DistributedSummary summary{};
+
+    std::vector<TopNode> tree;
+    std::vector<Subproblem> subproblems;
+    std::unordered_map<TTKey, int> keys;
+    build_tree(tree, subproblems, keys, our_bb, their_bb, Empty_BB, std::max(0, split_ply));
+
+    // nothing to split: the game ends within a move, or the root is the only subproblem
+    if (tree[0].children.empty())
+    {
+        reset_search_stats();
+        summary.result = root_search_budget(our_bb, their_bb, 0.0, 0);
+        summary.nodes = search_stats().nodes;
+        return summary;
+    }
+
+    summary.num_subproblems = subproblems.size();
+
+    // a worker dying must not kill us when we write to its pipe
+    auto old_sigpipe = std::signal(SIGPIPE, SIG_IGN);
+
+    std::vector<Worker> workers(num_processes);
+    std::vector<pollfd> fds;
+    std::vector<int> polled; // the worker of each entry of fds
+
+    while (true)
+    {
+        update_bounds(tree, subproblems, 0);
+        if (tree[0].min == tree[0].max) break;
+
+        for (Subproblem & sub : subproblems) sub.needed = false;
+        mark_needed(tree, subproblems, 0, -SCORE_INFINITY, SCORE_INFINITY);
+
+        // stop the workers busy with subproblems which became useless, their scores would change nothing
+        for (Worker & worker : workers)
+        {
+            if (worker.subproblem < 0 || subproblems[worker.subproblem].needed) continue;
+
+            Subproblem & sub = subproblems[worker.subproblem];
+            sub.running = false;
+            --sub.attempts; // not its fault
+            stop_worker(worker, true);
+        }
+
+        // hand out the needed subproblems, in tree order
+        size_t next = 0;
+        for (Worker & worker : workers)
+        {
+            if (worker.subproblem >= 0) continue;
+
+            while (next < subproblems.size())
+            {
+                const Subproblem & sub = subproblems[next];
+                if (sub.needed && !sub.running && sub.attempts < DISTRIBUTED_MAX_ATTEMPTS) break;
+                ++next;
+            }
+            if (next == subproblems.size()) break;
+
+            if (worker.pid < 0 && !start_worker(worker, workers)) continue;
+
+            Subproblem & sub = subproblems[next];
+            WorkerJob job{sub.our_bb, sub.their_bb, sub.alpha, sub.beta};
+            ++sub.attempts;
+
+            // a worker which can't take the job died: its end is found when polling, like any other crash
+            write_all(worker.job_fd, &job, sizeof(job));
+
+            sub.running = true;
+            worker.subproblem = next++;
+        }
+
+        fds.clear();
+        polled.clear();
+        for (size_t w = 0; w < workers.size(); ++w)
+        {
+            if (workers[w].subproblem < 0) continue;
+            fds.push_back(pollfd{workers[w].reply_fd, POLLIN, 0});
+            polled.push_back(w);
+        }
+
+        // nothing left to try: some subproblem kept crashing its workers, or no worker could be started
+        if (fds.empty()) break;
+
+        if (poll(fds.data(), fds.size(), -1) < 0)
+        {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        for (size_t i = 0; i < fds.size(); ++i)
+        {
+            if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+
+            Worker & worker = workers[polled[i]];
+            Subproblem & sub = subproblems[worker.subproblem];
+            sub.running = false;
+
+            WorkerReply reply;
+            if (read_all(worker.reply_fd, &reply, sizeof(reply)))
+            {
+                // it may be needed again in a wider window, once its siblings are known better
+                sub.min = std::max(sub.min, reply.min);
+                sub.max = std::min(sub.max, reply.max);
+                sub.searched = true;
+                sub.attempts = 0;
+                worker.subproblem = -1;
+
+                ++summary.num_searches;
+                summary.nodes += reply.nodes;
+            }
+            else
+            {
+                // crashed: its subproblem goes back to the queue, with a new worker
+                std::cerr << "Worker " << worker.pid << " died, queueing its subproblem again\n";
+                ++summary.num_crashes;
+                stop_worker(worker, true);
+            }
+        }
+    }
+
+    // idle workers exit once their job pipe is closed, busy ones are only solving useless subproblems
+    for (Worker & worker : workers)
+    {
+        if (worker.pid >= 0) stop_worker(worker, worker.subproblem >= 0);
+    }
+
+    std::signal(SIGPIPE, old_sigpipe);
+
+    for (const Subproblem & sub : subproblems)
+    {
+        if (sub.min == sub.max) ++summary.num_solved;
+        if (!sub.searched) ++summary.num_skipped;
+    }
+
+    // the move proving the root's lower bound, exact once the root is solved
+    const TopNode & root = tree[0];
+    summary.result = SearchResult{root.min, root.max, tree[root.children.front()].move};
+    for (int child : root.children)
+    {
+        if (-tree[child].max == root.min)
+        {
+            summary.result.best_move = tree[child].move;
+            break;
+        }
+    }
+
+    return summary;
+}
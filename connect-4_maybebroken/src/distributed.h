@@ -0,0 +1,36 @@
+#pragma once
+
+#include "bitboard.h"
+#include "search.h"
+
+#include <cstddef>
+#include <cstdint>
+
+
+/// @brief Outcome of distributed_search.
+struct DistributedSummary
+{
+    SearchResult result; // exact, unless a subproblem kept crashing its workers
+    size_t num_subproblems; // positions at the split ply, transpositions and mirror images counting once
+    size_t num_solved; // subproblems whose score ended up exact
+    size_t num_skipped; // subproblems which never mattered to the root's score, or stopped mattering before a worker answered
+    size_t num_searches; // answers of the workers, a subproblem being searched again when needed in a wider window
+    size_t num_crashes; // workers which died while searching, their subproblem being queued again
+    uint64_t nodes; // searched by the workers
+};
+
+/// @brief Calculates value of a given root node like root_search, with the search split over several worker processes.
+/// The tree is expanded split_ply moves deep (non-losing moves only); each distinct position there is a subproblem,
+/// searched with root_search_window by forked worker processes, each with its own copy of the transposition table
+/// (so a table loaded before the call warms every worker up). The coordinator combines the bounds they return with
+/// negamax up to the root, and only asks for a subproblem in the window where it may still change the root's score.
+/// Subproblems which can no longer change it are skipped, and the workers busy with them stopped.
+/// A worker which dies is forked again and its subproblem queued again, up to DISTRIBUTED_MAX_ATTEMPTS times in a row.
+/// Workers search with the number of threads set by set_search_threads, and print nothing.
+/// The calling process must not run other threads during the call, as it forks.
+/// @param our_bb Our pieces.
+/// @param their_bb Our opponent's pieces.
+/// @param split_ply The depth of the subproblems, in moves from the root. 0 searches the root in this process.
+/// @param num_processes The number of worker processes, at least 1.
+/// @return The proven score interval and best move, and the run's totals.
+DistributedSummary distributed_search(Bitboard our_bb, Bitboard their_bb, int split_ply, int num_processes);
@@ -0,0 +1,215 @@
+/*
+   Bitboard helpers for any board size, as templates on the board's width and height.
+
+   Files are stacked as in bitboard.h: each takes (height + 1) bits, rank 1 first,
+   the extra bit being an always-empty sentinel that stops carries and shifts
+   from wrapping into the next file. Every mask and shift distance is computed
+   at compile time, so each size gets the same code as a hand-written version.
+*/
+
+#pragma once
+
+
+#include <cstdint>
+#include <type_traits>
+
+
+/// @brief Masks, shift distances and storage of a board of a given size.
+/// @tparam Width The number of files.
+/// @tparam Height The number of ranks.
+template <int Width, int Height>
+struct BoardGeometry
+{
+    static_assert(Width >= 4 && Height >= 4, "a board needs room for 4 in a row");
+
+    static constexpr int WIDTH = Width;
+    static constexpr int HEIGHT = Height;
+    static constexpr int FILE_BITS = Height + 1; // sentinel included
+    static constexpr int NUM_BITS = Width * FILE_BITS;
+    static constexpr int NUM_STONES = Width * Height;
+
+    // shift distances from a tile to its neighbour in each line direction
+    static constexpr int VERTICAL = 1;
+    static constexpr int HORIZONTAL = FILE_BITS;
+    static constexpr int DIAGONAL_DOWN = FILE_BITS - 1; // '\'
+    static constexpr int DIAGONAL_UP = FILE_BITS + 1; // '/'
+
+    // winning_positions shifts pairs of stones one step past the last file before shifting them back
+    static constexpr int STORAGE_BITS = NUM_BITS + DIAGONAL_UP;
+
+    static_assert(STORAGE_BITS <= 128, "boards are stored in at most 128 bits");
+
+    /// @brief The smallest unsigned integer holding the whole board and the spare bits above it.
+    using Board = std::conditional_t<STORAGE_BITS <= 64, uint64_t, unsigned __int128>;
+
+    /// @brief Construct a bitboard of one tile.
+    /// @param file The tile's file, from 0.
+    /// @param rank The tile's rank, from 0.
+    /// @return The bitboard
+    static constexpr Board square(int file, int rank)
+    {
+        return Board(1) << (FILE_BITS * file + rank);
+    }
+
+    /// @brief Construct a bitboard of a whole file, without its sentinel.
+    /// @param file The file, from 0.
+    /// @return The bitboard
+    static constexpr Board file(int file)
+    {
+        return ((Board(1) << Height) - 1) << (FILE_BITS * file);
+    }
+
+    /// @brief Construct a bitboard of a whole rank, across all files.
+    /// @param rank The rank, from 0 (Height being the sentinel rank).
+    /// @return The bitboard
+    static constexpr Board rank(int rank)
+    {
+        Board result = 0;
+        for (int f = 0; f < Width; ++f) result |= square(f, rank);
+        return result;
+    }
+
+    /// @brief Construct a bitboard of every other rank, across all files.
+    /// @param first The lowest rank, from 0.
+    /// @return The bitboard
+    static constexpr Board every_other_rank(int first)
+    {
+        Board result = 0;
+        for (int r = first; r < Height; r += 2) result |= rank(r);
+        return result;
+    }
+
+    static constexpr Board Bottom_BB = rank(0);
+    static constexpr Board Sentinel_BB = rank(Height);
+    static constexpr Board All_Tiles_BB = (Bottom_BB << Height) - Bottom_BB; // all ranks but the sentinel
+
+    // ranks by parity, numbered from 1 at the bottom, for zugzwang (see threats.h)
+    static constexpr Board Odd_Ranks_BB = every_other_rank(0);
+    static constexpr Board Even_Ranks_BB = every_other_rank(1);
+};
+
+
+/// @brief Count the set bits of a bitboard of any size.
+/// @tparam G The board's geometry.
+/// @param bb The bitboard
+/// @return The count
+template <class G>
+constexpr int popcount(typename G::Board bb)
+{
+    if constexpr (sizeof(bb) <= sizeof(unsigned long long)) return __builtin_popcountll(bb);
+    else return __builtin_popcountll(static_cast<uint64_t>(bb)) + __builtin_popcountll(static_cast<uint64_t>(bb >> 64));
+}
+
+/// @brief Find the least significant set bit of a bitboard of any size.
+/// @tparam G The board's geometry.
+/// @param bb The bitboard, not empty.
+/// @return The bit's index.
+template <class G>
+constexpr int lsb_index(typename G::Board bb)
+{
+    if constexpr (sizeof(bb) <= sizeof(unsigned long long)) return __builtin_ctzll(bb);
+    else if (static_cast<uint64_t>(bb)) return __builtin_ctzll(static_cast<uint64_t>(bb));
+    else return 64 + __builtin_ctzll(static_cast<uint64_t>(bb >> 64));
+}
+
+/// @brief Mirror a bitboard left to right, sentinel rank included.
+/// @tparam G The board's geometry.
+/// @param bb The bitboard
+/// @return The mirrored bitboard
+template <class G>
+constexpr typename G::Board mirror(typename G::Board bb)
+{
+    constexpr typename G::Board File_Mask = (typename G::Board(1) << G::FILE_BITS) - 1;
+
+    typename G::Board result = 0;
+    for (int f = 0; f < G::WIDTH; ++f)
+    {
+        result |= ((bb >> (G::FILE_BITS * f)) & File_Mask) << (G::FILE_BITS * (G::WIDTH - 1 - f));
+    }
+    return result;
+}
+
+/// @brief Check whether a given bitboard contains a winning piece configuration.
+/// @tparam G The board's geometry.
+/// @param player_pieces The player's pieces
+/// @return Whether a win was found.
+template <class G>
+constexpr bool check_win(typename G::Board player_pieces)
+{
+    // pairs of stones, then two pairs two tiles apart, in each direction
+    auto has_line = [player_pieces](int d)
+    {
+        typename G::Board mask = player_pieces & (player_pieces >> d);
+        return (mask & (mask >> (2*d))) != 0;
+    };
+
+    return has_line(G::HORIZONTAL) || has_line(G::DIAGONAL_DOWN) || has_line(G::DIAGONAL_UP) || has_line(G::VERTICAL);
+}
+
+/// @brief Generate all legal moves from a position.
+/// @tparam G The board's geometry.
+/// @param our_bb Our pieces.
+/// @param their_bb Our opponent's pieces.
+/// @return A bitboard of all our legal moves.
+template <class G>
+constexpr typename G::Board possible_moves(typename G::Board our_bb, typename G::Board their_bb)
+{
+    // adding the bottom tile of each file ripples a carry up to its first empty tile
+    return ((our_bb|their_bb) + G::Bottom_BB) & G::All_Tiles_BB;
+}
+
+/// @brief Generate all tiles where we would win if we placed a stone.
+/// @tparam G The board's geometry.
+/// @param our_bb Our pieces.
+/// @param their_bb Our opponent's pieces.
+/// @return A bitboard of our winning positions.
+template <class G>
+constexpr typename G::Board winning_positions(typename G::Board our_bb, typename G::Board their_bb)
+{
+    using Board = typename G::Board;
+
+    // VERTICAL: only stones below can complete the line
+    Board result = (our_bb << 1) & (our_bb << 2) & (our_bb << 3);
+
+    // other directions: a pair of stones, then the two possible missing stones on each side of it
+    auto add_line = [our_bb, &result](int d)
+    {
+        Board partial = (our_bb << d) & (our_bb << (2*d));
+        result |= (partial & (our_bb << (3*d)));
+        result |= (partial & (our_bb >> d));
+
+        partial >>= (3*d);
+        result |= (partial & (our_bb << d));
+        result |= (partial & (our_bb >> (3*d)));
+    };
+
+    add_line(G::HORIZONTAL);
+    add_line(G::DIAGONAL_DOWN);
+    add_line(G::DIAGONAL_UP);
+
+    // constrain result to empty tiles
+    return (result & (G::All_Tiles_BB ^ (our_bb|their_bb)));
+}
+
+/// @brief Keep the legal moves which do not make us lose when our opponent replies.
+/// @tparam G The board's geometry.
+/// @param possible Our legal moves.
+/// @param opponent_win Our opponent's winning positions, as returned by winning_positions.
+/// @return A bitboard of all our non-losing moves.
+template <class G>
+constexpr typename G::Board non_losing_moves(typename G::Board possible, typename G::Board opponent_win)
+{
+    // we must play these to not lose
+    typename G::Board forced = possible & opponent_win;
+
+    if (forced)
+    {
+        // more than one opponent win possible: we lose anyway
+        if (forced & (forced-1)) return 0;
+
+        possible = forced;
+    }
+
+    // don't play under a winning position
+    return possible & ~(opponent_win >> 1);
+}
@@ -0,0 +1,382 @@
+// Geometry check: plays random games on boards of several sizes, and checks the bitboard helpers of geometry.h
+// (check_win, winning_positions, possible_moves, non_losing_moves, mirror, popcount) against plain scans of a
+// board of squares at every ply, and lsb_index on every square. The 8x7 and 9x7 boards don't fit 64 bits, which
+// covers the 128-bit path. Then it solves random positions with the solver of each board size it is built for,
+// and checks their scores against a plain minimax.
+//
+// Usage: geometry_check [--games N] [--solves N] [--seed S]
+// A line per board size and check goes to stderr, with the first mismatches found.
+// The exit status is non-zero if anything differs.
+
+#include "constants.h"
+#include "geometry.h"
+#include "search.h"
+#include "tt.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+
+// mismatches printed per board size and check, the others are only counted
+constexpr int MAX_REPORTED_MISMATCHES = 5;
+
+/// @brief A board of squares, the reference the bitboards are checked against.
+/// @tparam G The board's geometry.
+template <class G>
+class SquareBoard
+{
+public:
+    using Board = typename G::Board;
+
+    static constexpr int EMPTY = -1;
+
+    SquareBoard()
+    {
+        for (auto & file : m_squares) std::fill(std::begin(file), std::end(file), EMPTY);
+    }
+
+    /// @brief Get a square's player, EMPTY if none.
+    int at(int file, int rank) const
+    {
+        bool inside = file >= 0 && file < G::WIDTH && rank >= 0 && rank < G::HEIGHT;
+        return inside ? m_squares[file][rank] : EMPTY;
+    }
+
+    /// @brief Get the lowest empty rank of a file, G::HEIGHT if full.
+    int height(int file) const
+    {
+        int rank = 0;
+        while (rank < G::HEIGHT && m_squares[file][rank] != EMPTY) ++rank;
+        return rank;
+    }
+
+    /// @brief Drop a player's stone into a file, which must not be full.
+    void play(int file, int player)
+    {
+        m_squares[file][height(file)] = player;
+    }
+
+    /// @brief Get a player's stones as a bitboard, built square by square.
+    Board stones(int player) const
+    {
+        Board result = 0;
+        for (int f = 0; f < G::WIDTH; ++f)
+            for (int r = 0; r < G::HEIGHT; ++r)
+                if (m_squares[f][r] == player) result |= G::square(f, r);
+        return result;
+    }
+
+    /// @brief Count a player's stones.
+    int count(int player) const
+    {
+        int result = 0;
+        for (int f = 0; f < G::WIDTH; ++f)
+            for (int r = 0; r < G::HEIGHT; ++r)
+                if (m_squares[f][r] == player) ++result;
+        return result;
+    }
+
+    /// @brief Count the stones of a player in a row through a square, in both senses of a direction,
+    /// the square itself included whatever it holds.
+    int run(int file, int rank, int df, int dr, int player) const
+    {
+        int result = 1;
+        for (int i = 1; at(file + i*df, rank + i*dr) == player; ++i) ++result;
+        for (int i = 1; at(file - i*df, rank - i*dr) == player; ++i) ++result;
+        return result;
+    }
+
+    /// @brief Check whether a player's stone on a square would be in a line of 4.
+    bool completes_line(int file, int rank, int player) const
+    {
+        return run(file, rank, 1, 0, player) >= 4 || run(file, rank, 0, 1, player) >= 4
+            || run(file, rank, 1, 1, player) >= 4 || run(file, rank, 1, -1, player) >= 4;
+    }
+
+    /// @brief Check whether a player has 4 in a row.
+    bool has_won(int player) const
+    {
+        for (int f = 0; f < G::WIDTH; ++f)
+            for (int r = 0; r < G::HEIGHT; ++r)
+                if (m_squares[f][r] == player && completes_line(f, r, player)) return true;
+        return false;
+    }
+
+    /// @brief Get the empty squares where a player's stone would complete a line of 4, playable or not.
+    Board winning_squares(int player) const
+    {
+        Board result = 0;
+        for (int f = 0; f < G::WIDTH; ++f)
+            for (int r = 0; r < G::HEIGHT; ++r)
+                if (m_squares[f][r] == EMPTY && completes_line(f, r, player)) result |= G::square(f, r);
+        return result;
+    }
+
+    /// @brief Get the lowest empty square of each file.
+    Board playable_squares() const
+    {
+        Board result = 0;
+        for (int f = 0; f < G::WIDTH; ++f)
+            if (height(f) < G::HEIGHT) result |= G::square(f, height(f));
+        return result;
+    }
+
+    /// @brief Get the moves of a player after which the opponent can't win at once.
+    Board safe_moves(int player) const
+    {
+        Board result = 0;
+        for (int f = 0; f < G::WIDTH; ++f)
+        {
+            if (height(f) == G::HEIGHT) continue;
+
+            SquareBoard next = *this;
+            next.play(f, player);
+            if ((next.winning_squares(1 - player) & next.playable_squares()) == 0) result |= G::square(f, height(f));
+        }
+        return result;
+    }
+
+    /// @brief Get the board mirrored left to right.
+    SquareBoard mirrored() const
+    {
+        SquareBoard result;
+        for (int f = 0; f < G::WIDTH; ++f)
+            for (int r = 0; r < G::HEIGHT; ++r)
+                result.m_squares[G::WIDTH - 1 - f][r] = m_squares[f][r];
+        return result;
+    }
+
+private:
+    int m_squares[G::WIDTH][G::HEIGHT];
+};
+
+/// @brief Mismatches of one check on one board size.
+struct CheckResult
+{
+    std::string name;
+    uint64_t checked = 0;
+    int mismatches = 0;
+
+    /// @brief Count a comparison, and report it if it failed.
+    /// @return Whether it matched.
+    bool expect(bool matched, const char * what, int game, int ply)
+    {
+        ++checked;
+        if (matched) return true;
+
+        if (mismatches++ < MAX_REPORTED_MISMATCHES)
+        {
+            std::cerr << name << ": " << what << " differs in game " << game << " at ply " << ply << '\n';
+        }
+        return false;
+    }
+
+    /// @brief Print the totals.
+    void report() const
+    {
+        std::cerr << name << ": " << checked << " comparisons, " << mismatches << " mismatches\n";
+    }
+};
+
+/// @brief Play random games, comparing the bitboard helpers to the board of squares before every move.
+/// @tparam G The board's geometry.
+/// @param name The board's name.
+/// @param num_games The number of games.
+/// @param rng The random number generator.
+/// @return The number of mismatches.
+template <class G>
+int check_geometry(const char * name, int num_games, std::mt19937_64 & rng)
+{
+    using Board = typename G::Board;
+
+    CheckResult result{std::string(name) + " bitboards"};
+
+    // the highest squares of the larger boards are in the upper half of a 128-bit board
+    for (int f = 0; f < G::WIDTH; ++f)
+        for (int r = 0; r <= G::HEIGHT; ++r)
+            result.expect(lsb_index<G>(G::square(f, r) | G::square(G::WIDTH - 1, G::HEIGHT)) == G::FILE_BITS * f + r,
+                          "lsb_index", 0, 0);
+
+    for (int game = 0; game < num_games; ++game)
+    {
+        SquareBoard<G> squares;
+        int player = 0;
+
+        for (int ply = 0; ; ++ply, player = 1 - player)
+        {
+            const Board our_bb = squares.stones(player);
+            const Board their_bb = squares.stones(1 - player);
+
+            result.expect(popcount<G>(our_bb) == squares.count(player)
+                       && popcount<G>(their_bb) == squares.count(1 - player), "popcount", game, ply);
+            result.expect(mirror<G>(our_bb) == squares.mirrored().stones(player), "mirror", game, ply);
+            result.expect(check_win<G>(their_bb) == squares.has_won(1 - player), "check_win", game, ply);
+
+            // the game is over, the previous player won or the board is full
+            if (squares.has_won(1 - player) || ply == G::NUM_STONES) break;
+
+            const Board possible = possible_moves<G>(our_bb, their_bb);
+            const Board their_win = winning_positions<G>(their_bb, our_bb);
+
+            result.expect(possible == squares.playable_squares(), "possible_moves", game, ply);
+            result.expect(winning_positions<G>(our_bb, their_bb) == squares.winning_squares(player),
+                          "winning_positions", game, ply);
+            result.expect(their_win == squares.winning_squares(1 - player), "winning_positions", game, ply);
+            result.expect(non_losing_moves<G>(possible, their_win) == squares.safe_moves(player),
+                          "non_losing_moves", game, ply);
+
+            // a random legal move
+            std::vector<int> files;
+            for (int f = 0; f < G::WIDTH; ++f) if (squares.height(f) < G::HEIGHT) files.push_back(f);
+            squares.play(files[rng() % files.size()], player);
+        }
+    }
+
+    result.report();
+    return result.mismatches;
+}
+
+/// @brief Hash a key of any board size, for minimax's table of solved positions.
+/// @tparam G The board's geometry.
+template <class G>
+struct KeyHash
+{
+    size_t operator()(typename G::Board key) const
+    {
+        uint64_t high = static_cast<uint64_t>(static_cast<unsigned __int128>(key) >> 64);
+        return std::hash<uint64_t>()(static_cast<uint64_t>(key) ^ high * TT_WIDE_HASH_MULTIPLIER);
+    }
+};
+
+// minimax scores by position key
+template <class G>
+using ScoreTable = std::unordered_map<typename G::Board, int, KeyHash<G>>;
+
+/// @brief Score a position by plain minimax, as the solver does: abs(score) - 1 is the number of empty squares left
+/// when the winning stone is played, before it, and 0 is a draw.
+/// @tparam G The board's geometry.
+/// @param our_bb Our pieces (the player to move).
+/// @param their_bb Our opponent's pieces.
+/// @param scores The scores of the positions solved so far, by key.
+/// @return The score.
+template <class G>
+int minimax(typename G::Board our_bb, typename G::Board their_bb, ScoreTable<G> & scores)
+{
+    using Board = typename G::Board;
+
+    const int depth_left = G::NUM_STONES - popcount<G>(our_bb|their_bb);
+    if (depth_left == 0) return 0;
+
+    const Board key = make_key<G>(our_bb, their_bb);
+    auto found = scores.find(key);
+    if (found != scores.end()) return found->second;
+
+    int best = -depth_left - 1;
+    for (Board moves = possible_moves<G>(our_bb, their_bb); moves; moves &= moves - 1)
+    {
+        const Board move = moves & -moves;
+        if (check_win<G>(our_bb | move))
+        {
+            best = depth_left + 1;
+            break;
+        }
+        best = std::max(best, -minimax<G>(their_bb, our_bb | move, scores));
+    }
+
+    scores.emplace(key, best);
+    return best;
+}
+
+/// @brief Solve random positions, comparing the solver's scores to minimax.
+/// @tparam G The board's geometry.
+/// @param name The board's name.
+/// @param num_solves The number of positions.
+/// @param min_stones The fewest stones on a position, to keep minimax fast.
+/// @param rng The random number generator.
+/// @return The number of mismatches.
+template <class G>
+int check_solver(const char * name, int num_solves, int min_stones, std::mt19937_64 & rng)
+{
+    using Board = typename G::Board;
+
+    CheckResult result{std::string(name) + " solver"};
+    ScoreTable<G> scores;
+
+    for (int solve = 0; solve < num_solves; )
+    {
+        // a random game, stopped at a random ply if still going
+        const int plies = min_stones + static_cast<int>(rng() % (G::NUM_STONES - min_stones));
+
+        Board our_bb = 0, their_bb = 0;
+        bool over = false;
+        for (int ply = 0; ply < plies && !over; ++ply)
+        {
+            std::vector<Board> moves;
+            for (Board m = possible_moves<G>(our_bb, their_bb); m; m &= m - 1) moves.push_back(m & -m);
+
+            Board next = our_bb | moves[rng() % moves.size()];
+            over = check_win<G>(next);
+            our_bb = their_bb;
+            their_bb = next;
+        }
+        if (over) continue;
+
+        const int expected = minimax<G>(our_bb, their_bb, scores);
+        int score;
+        if constexpr (std::is_same_v<G, StandardGeometry>) score = root_search(our_bb, their_bb, false);
+        else score = root_search<G>(our_bb, their_bb, false);
+        result.expect(score == expected, "score", solve, plies);
+
+        ++solve;
+    }
+
+    result.report();
+    return result.mismatches;
+}
+
+int main(int argc, char *argv[])
+{
+    int num_games = GEOMETRY_CHECK_GAMES;
+    int num_solves = GEOMETRY_CHECK_SOLVES;
+    uint64_t seed = 1;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--games") == 0 && i+1 < argc) num_games = std::max(0, std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--solves") == 0 && i+1 < argc) num_solves = std::max(0, std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--seed") == 0 && i+1 < argc) seed = std::strtoull(argv[++i], nullptr, 10);
+        else
+        {
+            std::cerr << "Usage: geometry_check [--games N] [--solves N] [--seed S]\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::mt19937_64 rng(seed);
+    set_search_verbose(false);
+
+    int mismatches = 0;
+
+    mismatches += check_geometry<BoardGeometry<4, 4>>("4x4", num_games, rng);
+    mismatches += check_geometry<BoardGeometry<6, 5>>("6x5", num_games, rng);
+    mismatches += check_geometry<StandardGeometry>("7x6", num_games, rng);
+    mismatches += check_geometry<BoardGeometry<8, 7>>("8x7", num_games, rng);
+    mismatches += check_geometry<BoardGeometry<9, 7>>("9x7", num_games, rng);
+
+    // minimax is only fast enough near the end of the larger boards' games
+    mismatches += check_solver<BoardGeometry<4, 4>>("4x4", num_solves, 0, rng);
+    mismatches += check_solver<BoardGeometry<5, 4>>("5x4", num_solves, 4, rng);
+    mismatches += check_solver<BoardGeometry<6, 5>>("6x5", num_solves, 16, rng);
+    mismatches += check_solver<StandardGeometry>("7x6", num_solves, 28, rng);
+    mismatches += check_solver<BoardGeometry<8, 7>>("8x7", num_solves, 42, rng);
+    mismatches += check_solver<BoardGeometry<9, 7>>("9x7", num_solves, 49, rng);
+
+    return mismatches ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,65 @@
+#include "headered_file.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+HeaderedFileWriter::~HeaderedFileWriter()
+{
+    abandon();
+}
+
+bool HeaderedFileWriter::open(const char * path, size_t header_size)
+{
+    abandon();
+
+    m_path = path;
+    m_tmp_path = m_path + ".tmp";
+    m_header_size = header_size;
+
+    m_file = std::fopen(m_tmp_path.c_str(), "wb");
+    if (!m_file) return false;
+
+    // the header is only known once the data is written: reserve its block
+    std::vector<char> header_block(header_size);
+    m_ok = std::fwrite(header_block.data(), 1, header_size, m_file) == header_size;
+
+    return m_ok;
+}
+
+bool HeaderedFileWriter::write(const void * data, size_t size)
+{
+    if (m_file && m_ok) m_ok = std::fwrite(data, 1, size, m_file) == size;
+
+    return m_file && m_ok;
+}
+
+bool HeaderedFileWriter::close(const void * header, size_t size)
+{
+    if (!m_file) return false;
+
+    // header, zero-padded to its full block
+    std::vector<char> header_block(m_header_size);
+    std::memcpy(header_block.data(), header, std::min(size, m_header_size));
+
+    bool ok = m_ok && size <= m_header_size && std::fseek(m_file, 0, SEEK_SET) == 0
+           && std::fwrite(header_block.data(), 1, m_header_size, m_file) == m_header_size;
+
+    // closing flushes, which may fail too
+    ok = (std::fclose(m_file) == 0) && ok;
+    m_file = nullptr;
+
+    if (ok) ok = std::rename(m_tmp_path.c_str(), m_path.c_str()) == 0;
+    if (!ok) std::remove(m_tmp_path.c_str());
+
+    return ok;
+}
+
+void HeaderedFileWriter::abandon()
+{
+    if (!m_file) return;
+
+    std::fclose(m_file);
+    m_file = nullptr;
+    std::remove(m_tmp_path.c_str());
+}
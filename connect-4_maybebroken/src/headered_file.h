@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+
+
+/// @brief Writes a file made of a fixed-size header block followed by data, as the opening book, the
+/// transposition table, corpus and trace files are. The header is written last, once the data is known,
+/// and the file is written next to its destination then renamed over it, so a crash or a failed write
+/// never leaves a truncated file behind.
+class HeaderedFileWriter
+{
+public:
+    HeaderedFileWriter() = default;
+
+    /// @brief NO COPY CONSTRUCTOR ALLOWED
+    HeaderedFileWriter(const HeaderedFileWriter&) = delete;
+
+    /// @brief Abandon the file if it wasn't closed.
+    ~HeaderedFileWriter();
+
+    /// @brief Start writing a file, reserving its zeroed header block. Any file being written is abandoned first.
+    /// @param path The file's path, replaced only once the whole file is written (by close).
+    /// @param header_size The size of the header block.
+    /// @return Whether the file could be created.
+    bool open(const char * path, size_t header_size);
+
+    /// @brief Append data after what was written so far. Nothing is written once a write failed.
+    /// @return Whether every write succeeded so far.
+    bool write(const void * data, size_t size);
+
+    /// @brief Finish the file: write its header at the start of the header block and move the file to its path.
+    /// @param header The header, the rest of its block staying zero.
+    /// @param size The header's size, at most the header block's.
+    /// @return Whether the whole file was written successfully. If not, nothing is left at its path.
+    bool close(const void * header, size_t size);
+
+    /// @brief Stop writing the file and remove it, if any.
+    void abandon();
+
+    /// @brief Check whether a file is being written.
+    bool is_open() const { return m_file; }
+
+private:
+    std::FILE * m_file = nullptr;
+    std::string m_path; // the destination
+    std::string m_tmp_path; // written to until close renames it
+    size_t m_header_size = 0;
+    bool m_ok = false; // whether every write succeeded so far
+};
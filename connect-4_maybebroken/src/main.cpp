@@ -1,20 +1,320 @@
 #include "bitboard.h"
 #include "search.h"
 #include "display.h"
+#include "book.h"
+#include "tt.h"
+#include "trace.h"
+#include "batch.h"
+#include "corpus.h"
+#include "annotate.h"
+#include "daemon.h"
+#include "distributed.h"
+#include "notation.h"
 
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <thread>
 
 
-int main([[maybe_unused]] int argc, [[maybe_unused]] char *argv[])
+/// @brief Solve a position on another board size, printing the results as for the standard board.
+/// @tparam G The board's geometry, one the solver is built for (see search.h).
+/// @param position The position, as a move string or two bitboards, nullptr for the empty board.
+/// @param max_seconds Time budget in seconds, 0 for none.
+/// @param max_nodes Node budget, 0 for none.
+/// @return The exit status.
+template <class G>
+static int solve_on_board(const char * position, double max_seconds, uint64_t max_nodes)
 {
-    Bitboard red_bb = (SQ_A1|SQ_A2|SQ_B3|SQ_B4|SQ_C1|SQ_C3|SQ_D1|SQ_E2|SQ_F1);
-    Bitboard yellow_bb = (SQ_A3|SQ_A4|SQ_B1|SQ_B2|SQ_C2|SQ_C4|SQ_D2|SQ_D3|SQ_E1);
+    typename G::Board our_bb = Empty_BB;
+    typename G::Board their_bb = Empty_BB;
 
-    display_bitboard_2player(Empty_BB, Empty_BB);
+    if (position && !parse_position<G>(position, our_bb, their_bb))
+    {
+        std::cerr << "Invalid position " << position << '\n';
+        return EXIT_FAILURE;
+    }
 
-    // get score for position
-    int score = root_search(Empty_BB, Empty_BB, false);
-    std::cout << "score : " << score << '\n';
+    auto start = std::chrono::steady_clock::now();
 
+    BasicSearchResult<G> result = root_search_budget<G>(our_bb, their_bb, max_seconds, max_nodes);
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    if (result.min == result.max) std::cout << "score : " << result.min << '\n';
+    else std::cout << "score : [" << result.min << "; " << result.max << "] (out of budget)\n";
+    std::cout << "best move : " << move_column<G>(result.best_move) << '\n';
+    std::cout << "time : " << elapsed.count() << "s\n";
+
+    print_search_stats(search_stats(), std::cout);
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
+
+int main(int argc, char *argv[])
+{
+    const char * book_path = BOOK_DEFAULT_PATH;
+    const char * tt_load_path = nullptr;
+    const char * tt_save_path = nullptr;
+    size_t tt_size_mb = TT_DEFAULT_SIZE_MB;
+    bool tt_huge_pages = false;
+    const char * batch_path = nullptr;
+    const char * annotate_path = nullptr;
+    int first_ply = 0;
+    const char * daemon_path = nullptr;
+    int num_workers = std::thread::hardware_concurrency();
+    int num_processes = 0;
+    int split_ply = DISTRIBUTED_DEFAULT_SPLIT_PLY;
+    const char * position = nullptr;
+    const char * board = "7x6";
+    double max_seconds = 0.0;
+    uint64_t max_nodes = 0;
+    bool analyze = false;
+    const char * trace_path = nullptr;
+    int trace_min_depth = TRACE_DEFAULT_MIN_DEPTH;
+    int trace_sample_log2 = TRACE_DEFAULT_SAMPLE_LOG2;
+    int status = EXIT_SUCCESS;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--book") == 0 && i+1 < argc) book_path = argv[++i];
+        else if (std::strcmp(argv[i], "--threads") == 0 && i+1 < argc) set_search_threads(std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--tt-load") == 0 && i+1 < argc) tt_load_path = argv[++i];
+        else if (std::strcmp(argv[i], "--tt-save") == 0 && i+1 < argc) tt_save_path = argv[++i];
+        else if (std::strcmp(argv[i], "--tt-size") == 0 && i+1 < argc) tt_size_mb = std::strtoull(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "--tt-huge-pages") == 0) tt_huge_pages = true;
+        else if (std::strcmp(argv[i], "--batch") == 0 && i+1 < argc) batch_path = argv[++i];
+        else if (std::strcmp(argv[i], "--annotate") == 0 && i+1 < argc) annotate_path = argv[++i];
+        else if (std::strcmp(argv[i], "--from-ply") == 0 && i+1 < argc) first_ply = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--daemon") == 0 && i+1 < argc) daemon_path = argv[++i];
+        else if (std::strcmp(argv[i], "--workers") == 0 && i+1 < argc) num_workers = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--processes") == 0 && i+1 < argc) num_processes = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--split-ply") == 0 && i+1 < argc) split_ply = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--position") == 0 && i+1 < argc) position = argv[++i];
+        else if (std::strcmp(argv[i], "--board") == 0 && i+1 < argc) board = argv[++i];
+        else if (std::strcmp(argv[i], "--time") == 0 && i+1 < argc) max_seconds = std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "--nodes") == 0 && i+1 < argc) max_nodes = std::strtoull(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "--analyze") == 0) analyze = true;
+        else if (std::strcmp(argv[i], "--trace") == 0 && i+1 < argc) trace_path = argv[++i];
+        else if (std::strcmp(argv[i], "--trace-depth") == 0 && i+1 < argc) trace_min_depth = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--trace-sample") == 0 && i+1 < argc) trace_sample_log2 = std::atoi(argv[++i]);
+        else
+        {
+            // unknown flags and missing values must not fall through to an empty-board solve
+            std::cerr << "Usage: connect4 [--position P [--analyze | --processes N [--split-ply N]] [--time S] [--nodes N]] [--board WxH]\n"
+                         "                [--batch FILE|- | --annotate FILE|- [--from-ply N] | --daemon SOCKET] [--workers N]\n"
+                         "                [--threads N] [--book PATH] [--tt-size MB] [--tt-huge-pages]\n"
+                         "                [--tt-load PATH] [--tt-save PATH] [--trace FILE [--trace-depth N] [--trace-sample K]]\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    // the other board sizes only solve single positions, the other modes assume the standard board
+    bool standard_board = std::strcmp(board, "7x6") == 0;
+    if (!standard_board && (batch_path || annotate_path || daemon_path || analyze || num_processes > 0))
+    {
+        std::cerr << "--board only applies to single position searches\n";
+        return EXIT_FAILURE;
+    }
+
+    // the book is optional, search falls back to negamax without it
+    // (reported on stderr, as stdout carries the results in batch and annotation modes)
+    if (book.open(book_path)) std::cerr << "Opening book: " << book.num_entries() << " entries\n";
+
+    // the default table is only mapped, replacing it costs nothing
+    if ((tt_size_mb != TT_DEFAULT_SIZE_MB || tt_huge_pages) && !tt.resize(tt_size_mb, tt_huge_pages))
+    {
+        std::cerr << "Could not allocate a " << tt_size_mb << "MB transposition table\n";
+        return EXIT_FAILURE;
+    }
+
+    // warm start from a previous run's table, if asked to (its size replaces ours)
+    if (tt_load_path && !tt.load_from_file(tt_load_path))
+    {
+        std::cerr << "Could not load transposition table from " << tt_load_path << ", starting cold\n";
+    }
+
+    if (trace_path)
+    {
+        if (!SEARCH_TRACE_ENABLED)
+        {
+            std::cerr << "Tracing needs a build with SEARCH_TRACE (cmake -DC4_SEARCH_TRACE=ON)\n";
+            return EXIT_FAILURE;
+        }
+
+        if (!search_trace.start(trace_path, trace_min_depth, trace_sample_log2))
+        {
+            std::cerr << "Could not create " << trace_path << '\n';
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (daemon_path)
+    {
+        // serves until interrupted, the table is saved below if asked
+        if (!run_daemon(daemon_path, num_workers))
+        {
+            std::cerr << "Could not listen on " << daemon_path << '\n';
+            return EXIT_FAILURE;
+        }
+    }
+    else if (batch_path)
+    {
+        std::ios::sync_with_stdio(false);
+
+        // a corpus file is solved in place, anything else is read as text ("-" reads positions from stdin)
+        Corpus corpus;
+        std::ifstream file;
+        if (std::strcmp(batch_path, "-") != 0 && !corpus.open(batch_path))
+        {
+            file.open(batch_path);
+            if (!file)
+            {
+                std::cerr << "Could not open " << batch_path << '\n';
+                return EXIT_FAILURE;
+            }
+        }
+
+        BatchSummary summary = corpus.is_open() ? run_batch_corpus(corpus, std::cout, num_workers)
+                                                : run_batch(file.is_open() ? file : std::cin, std::cout, num_workers);
+
+        std::cerr << summary.num_positions << " positions (" << summary.num_invalid << " invalid";
+        if (corpus.is_open()) std::cerr << ", " << summary.num_mismatches << " mismatches";
+        std::cerr << ") in " << summary.seconds << "s: " << summary.num_positions / summary.seconds << " positions/s\n";
+
+        // the table is still saved below
+        if (summary.num_mismatches) status = EXIT_FAILURE;
+    }
+    else if (annotate_path)
+    {
+        // "-" reads games from stdin
+        std::ifstream file;
+        if (std::strcmp(annotate_path, "-") != 0)
+        {
+            file.open(annotate_path);
+            if (!file)
+            {
+                std::cerr << "Could not open " << annotate_path << '\n';
+                return EXIT_FAILURE;
+            }
+        }
+
+        std::ios::sync_with_stdio(false);
+
+        AnnotateSummary summary = run_annotate(file.is_open() ? file : std::cin, std::cout, num_workers, first_ply);
+
+        std::cerr << summary.num_games << " games (" << summary.num_invalid << " invalid), " << summary.num_moves
+                  << " moves in " << summary.seconds << "s: " << summary.num_moves / summary.seconds << " moves/s\n";
+    }
+    else if (!standard_board)
+    {
+        // searched with their own transposition table, without opening book
+        if (std::strcmp(board, "9x7") == 0) status = solve_on_board<BoardGeometry<9, 7>>(position, max_seconds, max_nodes);
+        else if (std::strcmp(board, "8x7") == 0) status = solve_on_board<BoardGeometry<8, 7>>(position, max_seconds, max_nodes);
+        else if (std::strcmp(board, "6x5") == 0) status = solve_on_board<BoardGeometry<6, 5>>(position, max_seconds, max_nodes);
+        else if (std::strcmp(board, "5x4") == 0) status = solve_on_board<BoardGeometry<5, 4>>(position, max_seconds, max_nodes);
+        else if (std::strcmp(board, "4x4") == 0) status = solve_on_board<BoardGeometry<4, 4>>(position, max_seconds, max_nodes);
+        else
+        {
+            std::cerr << "Unsupported board " << board << " (7x6, 9x7, 8x7, 6x5, 5x4 or 4x4)\n";
+            return EXIT_FAILURE;
+        }
+    }
+    else
+    {
+        // the empty board unless a position was given
+        Bitboard our_bb = Empty_BB;
+        Bitboard their_bb = Empty_BB;
+
+        if (position && !parse_position(position, our_bb, their_bb))
+        {
+            std::cerr << "Invalid position " << position << '\n';
+            return EXIT_FAILURE;
+        }
+
+        // red is always the first player
+        if (popcount(our_bb) == popcount(their_bb)) display_bitboard_2player(our_bb, their_bb);
+        else display_bitboard_2player(their_bb, our_bb);
+
+        auto start = std::chrono::steady_clock::now();
+
+        if (analyze)
+        {
+            // every column's exact score and the principal variation (budgets don't apply)
+            PositionAnalysis analysis = analyze_position(our_bb, their_bb, true, true);
+
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+            std::cout << "score : " << analysis.score << '\n';
+            std::cout << "column scores :";
+            for (const ColumnAnalysis & column : analysis.columns)
+            {
+                if (column.legal) std::cout << ' ' << column.min;
+                else std::cout << " -";
+            }
+            std::cout << '\n';
+            std::cout << "best move : " << move_column(analysis.best_move) << '\n';
+            std::cout << "principal variation :";
+            for (Bitboard move : analysis.pv) std::cout << ' ' << move_column(move);
+            std::cout << '\n';
+            std::cout << "time : " << elapsed.count() << "s\n";
+
+            print_search_stats(search_stats(), std::cout);
+        }
+        else if (num_processes > 0)
+        {
+            // subtrees solved by worker processes (budgets don't apply)
+            DistributedSummary summary = distributed_search(our_bb, their_bb, split_ply, num_processes);
+            const SearchResult & result = summary.result;
+
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+            if (result.min == result.max) std::cout << "score : " << result.min << '\n';
+            else std::cout << "score : [" << result.min << "; " << result.max << "] (subproblems failed)\n";
+            std::cout << "best move : " << move_column(result.best_move) << '\n';
+            std::cout << "time : " << elapsed.count() << "s\n";
+            std::cout << "subproblems : " << summary.num_subproblems << " (" << summary.num_solved << " solved, "
+                      << summary.num_skipped << " skipped)\n";
+            std::cout << "worker searches : " << summary.num_searches << " (" << summary.num_crashes << " crashed)\n";
+            std::cout << "nodes : " << summary.nodes << '\n';
+
+            // some subproblems failed for good, the table is still saved below
+            if (result.min != result.max) status = EXIT_FAILURE;
+        }
+        else
+        {
+            // get score for position, possibly only bounds of it if a budget is set
+            SearchResult result = root_search_budget(our_bb, their_bb, max_seconds, max_nodes);
+
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+            if (result.min == result.max) std::cout << "score : " << result.min << '\n';
+            else std::cout << "score : [" << result.min << "; " << result.max << "] (out of budget)\n";
+            std::cout << "best move : " << move_column(result.best_move) << '\n';
+            std::cout << "time : " << elapsed.count() << "s\n";
+
+            print_search_stats(search_stats(), std::cout);
+        }
+    }
+
+    if (trace_path)
+    {
+        TraceSummary summary = search_trace.stop();
+        if (!summary.ok)
+        {
+            std::cerr << "Could not write " << trace_path << '\n';
+            status = EXIT_FAILURE;
+        }
+        else std::cerr << summary.num_records << " nodes traced to " << trace_path << ", "
+                       << summary.num_dropped << " dropped\n";
+    }
+
+    if (tt_save_path && !tt.save_to_file(tt_save_path))
+    {
+        std::cerr << "Could not save transposition table to " << tt_save_path << '\n';
+        return EXIT_FAILURE;
+    }
+
+    return status;
+}
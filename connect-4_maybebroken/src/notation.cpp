@@ -0,0 +1,127 @@
+#include "notation.h"
+
+#include "search_helpers.h"
+
+#include <cstdlib>
+#include <utility>
+
+
+template <class G>
+bool parse_moves(const std::string & moves, typename G::Board & our_bb, typename G::Board & their_bb)
+{
+    our_bb = Empty_BB;
+    their_bb = Empty_BB;
+
+    for (char c : moves)
+    {
+        if (c < '1' || c >= '1' + G::WIDTH) return false;
+
+        // the game is over, no more moves allowed
+        if (check_win<G>(their_bb)) return false;
+
+        typename G::Board move = possible_moves<G>(our_bb, their_bb) & G::file(c - '1');
+
+        // full column
+        if (move == Empty_BB) return false;
+
+        // the mover becomes the side which just played
+        their_bb = std::exchange(our_bb, their_bb) | move;
+    }
+
+    return true;
+}
+
+bool parse_moves(const std::string & moves, Bitboard & our_bb, Bitboard & their_bb)
+{
+    return parse_moves<StandardGeometry>(moves, our_bb, their_bb);
+}
+
+/// @brief valid_position on a board of any size.
+/// @tparam G The board's geometry.
+template <class G>
+static bool valid_position(typename G::Board our_bb, typename G::Board their_bb)
+{
+    typename G::Board all = our_bb | their_bb;
+
+    if ((our_bb & their_bb) || (all & ~G::All_Tiles_BB)) return false;
+
+    // every stone must rest on the bottom rank or on another stone
+    if (all & ~((all << 1) | G::Bottom_BB)) return false;
+
+    // the side to move has played as much as, or one less than, the other side
+    int diff = popcount<G>(their_bb) - popcount<G>(our_bb);
+    if (diff != 0 && diff != 1) return false;
+
+    return !check_win<G>(our_bb) && !check_win<G>(their_bb);
+}
+
+bool valid_position(Bitboard our_bb, Bitboard their_bb)
+{
+    return valid_position<StandardGeometry>(our_bb, their_bb);
+}
+
+template <class G>
+bool parse_position(const std::string & text, typename G::Board & our_bb, typename G::Board & their_bb)
+{
+    if (text.find_first_not_of(std::string("123456789", G::WIDTH)) == std::string::npos)
+    {
+        // a finished game has no position left to solve
+        return parse_moves<G>(text, our_bb, their_bb) && !check_win<G>(their_bb);
+    }
+
+    // bitboards are read as 64-bit numbers, larger boards' positions are only given as moves
+    if constexpr (G::NUM_BITS > 64) return false;
+
+    const char * begin = text.c_str();
+    char * end;
+
+    our_bb = std::strtoull(begin, &end, 0);
+    if (end == begin) return false;
+
+    // separator
+    while (*end == ' ' || *end == '\t' || *end == ',') ++end;
+
+    begin = end;
+    their_bb = std::strtoull(begin, &end, 0);
+    if (end == begin) return false;
+
+    // nothing else allowed after the second bitboard
+    while (*end == ' ' || *end == '\t' || *end == '\r') ++end;
+    if (*end != '\0') return false;
+
+    return valid_position<G>(our_bb, their_bb);
+}
+
+bool parse_position(const std::string & text, Bitboard & our_bb, Bitboard & their_bb)
+{
+    return parse_position<StandardGeometry>(text, our_bb, their_bb);
+}
+
+template <class G>
+int move_column(typename G::Board move)
+{
+    return move ? (lsb_index<G>(move) / G::FILE_BITS) + 1 : 0;
+}
+
+int move_column(Bitboard move)
+{
+    return move_column<StandardGeometry>(move);
+}
+
+
+// the other board sizes the solver is built for (see search.cpp)
+template bool parse_moves<BoardGeometry<6, 5>>(const std::string &, BoardGeometry<6, 5>::Board &, BoardGeometry<6, 5>::Board &);
+template bool parse_position<BoardGeometry<6, 5>>(const std::string &, BoardGeometry<6, 5>::Board &, BoardGeometry<6, 5>::Board &);
+template int move_column<BoardGeometry<6, 5>>(BoardGeometry<6, 5>::Board);
+template bool parse_moves<BoardGeometry<5, 4>>(const std::string &, BoardGeometry<5, 4>::Board &, BoardGeometry<5, 4>::Board &);
+template bool parse_position<BoardGeometry<5, 4>>(const std::string &, BoardGeometry<5, 4>::Board &, BoardGeometry<5, 4>::Board &);
+template int move_column<BoardGeometry<5, 4>>(BoardGeometry<5, 4>::Board);
+template bool parse_moves<BoardGeometry<4, 4>>(const std::string &, BoardGeometry<4, 4>::Board &, BoardGeometry<4, 4>::Board &);
+template bool parse_position<BoardGeometry<4, 4>>(const std::string &, BoardGeometry<4, 4>::Board &, BoardGeometry<4, 4>::Board &);
+template int move_column<BoardGeometry<4, 4>>(BoardGeometry<4, 4>::Board);
+template bool parse_moves<BoardGeometry<8, 7>>(const std::string &, BoardGeometry<8, 7>::Board &, BoardGeometry<8, 7>::Board &);
+template bool parse_position<BoardGeometry<8, 7>>(const std::string &, BoardGeometry<8, 7>::Board &, BoardGeometry<8, 7>::Board &);
+template int move_column<BoardGeometry<8, 7>>(BoardGeometry<8, 7>::Board);
+template bool parse_moves<BoardGeometry<9, 7>>(const std::string &, BoardGeometry<9, 7>::Board &, BoardGeometry<9, 7>::Board &);
+template bool parse_position<BoardGeometry<9, 7>>(const std::string &, BoardGeometry<9, 7>::Board &, BoardGeometry<9, 7>::Board &);
+template int move_column<BoardGeometry<9, 7>>(BoardGeometry<9, 7>::Board);
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "bitboard.h"
+
+#include <string>
+
+
+/// @brief Play a sequence of moves from the empty board.
+/// @param moves Columns played in order, as digits 1 (file A) to 7 (file G), e.g. "4453".
+/// @param our_bb Receives the pieces of the side to move.
+/// @param their_bb Receives the pieces of the side which just played.
+/// @return Whether the sequence is valid: only known columns, none overfilled, and no win before the last move.
+bool parse_moves(const std::string & moves, Bitboard & our_bb, Bitboard & their_bb);
+
+/// @brief parse_moves on a board of another size, columns being digits 1 to the board's width.
+/// Instantiated for the board sizes the solver is built for (see search.h).
+/// @tparam G The board's geometry.
+template <class G>
+bool parse_moves(const std::string & moves, typename G::Board & our_bb, typename G::Board & their_bb);
+
+/// @brief Check that two bitboards form a reachable-looking position.
+/// @param our_bb The pieces of the side to move.
+/// @param their_bb The pieces of the side which just played.
+/// @return Whether the pieces don't overlap, are stacked from the bottom, the stone counts match the side to move,
+/// and nobody has won yet.
+bool valid_position(Bitboard our_bb, Bitboard their_bb);
+
+/// @brief Read a position in either notation: a move string, or two bitboards
+/// (side to move first, decimal or 0x-prefixed hexadecimal) separated by whitespace or a comma.
+/// @param text The position's text.
+/// @param our_bb Receives the pieces of the side to move.
+/// @param their_bb Receives the pieces of the side which just played.
+/// @return Whether the text describes a valid position where the game isn't over yet.
+bool parse_position(const std::string & text, Bitboard & our_bb, Bitboard & their_bb);
+
+/// @brief parse_position on a board of another size. Boards of more than 64 bits only take move strings.
+/// @tparam G The board's geometry.
+template <class G>
+bool parse_position(const std::string & text, typename G::Board & our_bb, typename G::Board & their_bb);
+
+/// @brief Get the column of a move.
+/// @param move A bitboard with the move's square only.
+/// @return The column, as a digit 1 (file A) to 7 (file G), or 0 for the empty move.
+int move_column(Bitboard move);
+
+/// @brief move_column on a board of another size.
+/// @tparam G The board's geometry.
+template <class G>
+int move_column(typename G::Board move);
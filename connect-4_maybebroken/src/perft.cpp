@@ -0,0 +1,364 @@
+// Perft: counts the leaf positions a given number of moves deep, to check and time the move generator
+// (possible_moves, possible_non_losing_moves, winning_positions, check_win) apart from the solver.
+//
+// Usage: perft [--threads N] [--bulk on|off] [--hash MB] [--position P --depth N] [reference files...]
+// Without a position or reference files, the counts checked into bench/perft.txt are used. Each reference
+// line holds "position depth raw_count non_losing_count" ('#' starts a comment line, '-' is the empty board).
+// Two trees are counted for each line:
+// - raw: every legal move is played, and a position where somebody won is a leaf;
+// - non-losing: the solver's tree, where a position whose side to move can win at once is a leaf,
+//   and only the moves after which our opponent can't win at once are played.
+// A leaf only counts if it lies exactly at the depth asked for.
+// Bulk counting counts the last ply's moves without playing them. The hash table holds the counts of subtrees
+// (keyed by position and depth, mirror images sharing theirs). Threads take subtrees PERFT_SPLIT_PLY moves deep.
+// A human-readable report goes to stderr, and one JSON object per count to stdout.
+// The exit status is non-zero if any count differs from its reference.
+
+#include "constants.h"
+#include "notation.h"
+#include "search_helpers.h"
+#include "tt.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef BENCH_DIR
+#define BENCH_DIR "bench"
+#endif
+
+
+/// @brief Which moves are played.
+enum class PerftMode
+{
+    Raw,
+    NonLosing
+};
+
+/// @brief Subtree counts, shared by all threads without locks.
+/// Each slot stores the count and the position's tag xor'ed with it, so that a slot torn by concurrent writes
+/// reads as a miss (lockless hashing).
+class PerftTable
+{
+public:
+    /// @brief Create a table of about a given size, a power of two of slots.
+    /// @param megabytes The size, 0 for no table.
+    explicit PerftTable(size_t megabytes)
+    {
+        size_t num_slots = megabytes * (1ULL << 20) / sizeof(Slot);
+        if (num_slots == 0) return;
+
+        m_bits = 63 - __builtin_clzll(num_slots);
+        m_slots = std::vector<Slot>(size_t{1} << m_bits);
+    }
+
+    /// @brief Whether the table holds anything.
+    bool enabled() const { return m_bits != 0; }
+
+    /// @brief Look up the count of a subtree.
+    /// @param count Receives the count if found.
+    /// @return Whether it was found.
+    bool probe(Bitboard our_bb, Bitboard their_bb, int depth, PerftMode mode, uint64_t & count) const
+    {
+        uint64_t tag = make_tag(our_bb, their_bb, depth, mode);
+        const Slot & slot = m_slots[index(tag)];
+
+        uint64_t check = __atomic_load_n(&slot.check, __ATOMIC_RELAXED);
+        uint64_t value = __atomic_load_n(&slot.count, __ATOMIC_RELAXED);
+        if ((check ^ value) != tag) return false;
+
+        count = value;
+        return true;
+    }
+
+    /// @brief Store the count of a subtree, replacing whatever the slot held.
+    void save(Bitboard our_bb, Bitboard their_bb, int depth, PerftMode mode, uint64_t count)
+    {
+        uint64_t tag = make_tag(our_bb, their_bb, depth, mode);
+        Slot & slot = m_slots[index(tag)];
+
+        __atomic_store_n(&slot.check, tag ^ count, __ATOMIC_RELAXED);
+        __atomic_store_n(&slot.count, count, __ATOMIC_RELAXED);
+    }
+
+private:
+    struct Slot
+    {
+        uint64_t check; // the tag xor the count, 0 when unused
+        uint64_t count;
+    };
+
+    /// @brief Identify a subtree: its canonical key, depth and mode, never 0.
+    static uint64_t make_tag(Bitboard our_bb, Bitboard their_bb, int depth, PerftMode mode)
+    {
+        static_assert(TranspositionTable::KEY_BITS + 7 < 64, "depth and mode must fit above the key");
+        return make_canonical_key(our_bb, their_bb) | (static_cast<uint64_t>(depth) << TranspositionTable::KEY_BITS)
+             | (static_cast<uint64_t>(mode == PerftMode::NonLosing) << (TranspositionTable::KEY_BITS + 6));
+    }
+
+    size_t index(uint64_t tag) const
+    {
+        // Fibonacci hashing: keys of nearby positions differ in few, low bits
+        return (tag * 0x9E3779B97F4A7C15ULL) >> (64 - m_bits);
+    }
+
+    std::vector<Slot> m_slots;
+    int m_bits = 0; // log2 of the number of slots
+};
+
+/// @brief Settings of a count.
+struct PerftOptions
+{
+    PerftMode mode;
+    bool bulk; // count the last ply's moves without playing them
+    PerftTable * table; // nullptr if subtree counts aren't hashed
+};
+
+/// @brief Get the moves played from a position.
+/// @return The moves, empty if the position is a leaf.
+static Bitboard perft_moves(Bitboard our_bb, Bitboard their_bb, PerftMode mode)
+{
+    if (mode == PerftMode::Raw) return possible_moves(our_bb, their_bb);
+
+    // we would win right away, the solver looks no further
+    if (winning_positions(our_bb, their_bb) & possible_moves(our_bb, their_bb)) return Empty_BB;
+
+    return possible_non_losing_moves(our_bb, their_bb);
+}
+
+/// @brief Count the leaves of a subtree.
+/// @param our_bb Our pieces, the side to move.
+/// @param their_bb Our opponent's pieces. Must not hold a win.
+/// @param depth The depth of the leaves to count, in moves.
+/// @return The number of leaves.
+static uint64_t perft(Bitboard our_bb, Bitboard their_bb, int depth, const PerftOptions & options)
+{
+    if (depth == 0) return 1;
+
+    Bitboard moves = perft_moves(our_bb, their_bb, options.mode);
+
+    if (depth == 1 && options.bulk) return popcount(moves);
+
+    uint64_t count;
+    if (depth > 1 && options.table && options.table->probe(our_bb, their_bb, depth, options.mode, count)) return count;
+
+    count = 0;
+    for (; moves; moves &= moves - 1)
+    {
+        Bitboard child_their = our_bb | (moves & -moves);
+
+        // a won game has no moves left
+        if (check_win(child_their)) count += (depth == 1);
+        else count += perft(their_bb, child_their, depth - 1, options);
+    }
+
+    if (depth > 1 && options.table) options.table->save(our_bb, their_bb, depth, options.mode, count);
+
+    return count;
+}
+
+/// @brief A subtree left for a thread to count.
+struct PerftTask
+{
+    Bitboard our_bb;
+    Bitboard their_bb;
+    int depth;
+};
+
+/// @brief Split a count into the subtrees a few moves deep, counting the leaves met on the way.
+/// @param split_ply The depth of the subtrees, in moves.
+/// @param tasks Receives the subtrees.
+/// @return The number of leaves found above the subtrees.
+static uint64_t split_perft(Bitboard our_bb, Bitboard their_bb, int depth, int split_ply,
+                            PerftMode mode, std::vector<PerftTask> & tasks)
+{
+    // the last plies are cheaper to count than to hand out
+    if (split_ply == 0 || depth <= 2)
+    {
+        tasks.push_back(PerftTask{our_bb, their_bb, depth});
+        return 0;
+    }
+
+    uint64_t count = 0;
+    for (Bitboard moves = perft_moves(our_bb, their_bb, mode); moves; moves &= moves - 1)
+    {
+        Bitboard child_their = our_bb | (moves & -moves);
+
+        if (!check_win(child_their)) count += split_perft(their_bb, child_their, depth - 1, split_ply - 1, mode, tasks);
+    }
+
+    return count;
+}
+
+/// @brief Count the leaves of a position's tree, on several threads.
+/// @param num_threads The number of threads, at least 1.
+/// @return The number of leaves.
+static uint64_t parallel_perft(Bitboard our_bb, Bitboard their_bb, int depth, const PerftOptions & options,
+                               int num_threads)
+{
+    std::vector<PerftTask> tasks;
+    std::atomic<uint64_t> count{split_perft(our_bb, their_bb, depth, PERFT_SPLIT_PLY, options.mode, tasks)};
+
+    // each thread takes the next subtree not counted yet
+    std::atomic<size_t> next{0};
+
+    auto work = [&]()
+    {
+        uint64_t local = 0;
+        for (size_t i = next++; i < tasks.size(); i = next++)
+        {
+            local += perft(tasks[i].our_bb, tasks[i].their_bb, tasks[i].depth, options);
+        }
+        count += local;
+    };
+
+    std::vector<std::thread> threads;
+    for (int t = 1; t < std::min<int>(num_threads, tasks.size()); ++t)
+    {
+        threads.emplace_back(work);
+    }
+
+    work();
+
+    for (auto & thread : threads) thread.join();
+
+    return count;
+}
+
+/// @brief Get a mode's name, as reported.
+static const char * mode_name(PerftMode mode)
+{
+    return mode == PerftMode::Raw ? "raw" : "non-losing";
+}
+
+/// @brief Count and report one tree, for humans to stderr and as a JSON object to stdout.
+/// @param checked Whether there is a reference count.
+/// @param expected The reference count.
+/// @return Whether the count matches its reference, if any.
+static bool run_perft(const std::string & position, Bitboard our_bb, Bitboard their_bb, int depth, PerftMode mode,
+                      bool checked, uint64_t expected, bool bulk, PerftTable * table, int num_threads)
+{
+    auto start = std::chrono::steady_clock::now();
+    uint64_t count = parallel_perft(our_bb, their_bb, depth, PerftOptions{mode, bulk, table}, num_threads);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    double seconds = elapsed.count();
+    double leaves_per_sec = seconds > 0.0 ? count / seconds : 0.0;
+    bool match = !checked || count == expected;
+
+    std::cerr << position << " depth " << depth << ' ' << mode_name(mode) << ": " << count;
+    if (checked) std::cerr << (match ? " (ok)" : " (expected " + std::to_string(expected) + ")");
+    std::cerr << ", " << seconds*1e3 << " ms, " << leaves_per_sec << " leaves/s\n";
+
+    std::cout << "{\"position\":\"" << position << "\",\"depth\":" << depth << ",\"mode\":\"" << mode_name(mode)
+              << "\",\"leaves\":" << count;
+    if (checked) std::cout << ",\"expected\":" << expected << ",\"match\":" << (match ? "true" : "false");
+    std::cout << ",\"ms\":" << seconds*1e3 << ",\"leaves_per_sec\":" << leaves_per_sec << "}\n";
+
+    return match;
+}
+
+/// @brief Read a position, '-' being the empty board.
+static bool parse_perft_position(const std::string & text, Bitboard & our_bb, Bitboard & their_bb)
+{
+    return parse_position(text == "-" ? "" : text, our_bb, their_bb);
+}
+
+/// @brief Count every line of a reference file.
+/// @param mismatches Receives the number of counts which differ from their references, and of bad lines.
+/// @return Whether the file could be read.
+static bool run_file(const std::string & path, bool bulk, PerftTable * table, int num_threads, int & mismatches)
+{
+    std::ifstream file(path);
+    if (!file) return false;
+
+    std::string line;
+    while (std::getline(file, line))
+    {
+        // tolerate CRLF files
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty() || line[0] == '#') continue;
+
+        std::istringstream fields(line);
+        std::string position;
+        int depth;
+        uint64_t raw, non_losing;
+
+        Bitboard our_bb, their_bb;
+        if (!(fields >> position >> depth >> raw >> non_losing) || depth < 0
+            || !parse_perft_position(position, our_bb, their_bb))
+        {
+            std::cerr << path << ": bad line \"" << line << "\"\n";
+            ++mismatches;
+            continue;
+        }
+
+        mismatches += !run_perft(position, our_bb, their_bb, depth, PerftMode::Raw, true, raw, bulk, table, num_threads);
+        mismatches += !run_perft(position, our_bb, their_bb, depth, PerftMode::NonLosing, true, non_losing, bulk, table,
+                                 num_threads);
+    }
+
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    std::vector<std::string> paths;
+    const char * position = nullptr;
+    int depth = -1;
+    int num_threads = 1;
+    bool bulk = true;
+    size_t hash_mb = 0;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--threads") == 0 && i+1 < argc) num_threads = std::max(1, std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--bulk") == 0 && i+1 < argc) bulk = std::strcmp(argv[++i], "off") != 0;
+        else if (std::strcmp(argv[i], "--hash") == 0 && i+1 < argc) hash_mb = std::strtoull(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "--position") == 0 && i+1 < argc) position = argv[++i];
+        else if (std::strcmp(argv[i], "--depth") == 0 && i+1 < argc) depth = std::atoi(argv[++i]);
+        else paths.push_back(argv[i]);
+    }
+
+    PerftTable table(hash_mb);
+    PerftTable * table_ptr = table.enabled() ? &table : nullptr;
+
+    std::cerr << "threads: " << num_threads << ", bulk counting: " << (bulk ? "on" : "off")
+              << ", hash table: " << hash_mb << "MB\n";
+
+    int mismatches = 0;
+
+    if (position || depth >= 0)
+    {
+        Bitboard our_bb, their_bb;
+        std::string text = position ? position : "-";
+        if (depth < 0 || !parse_perft_position(text, our_bb, their_bb))
+        {
+            std::cerr << "Invalid position or depth\n";
+            return EXIT_FAILURE;
+        }
+
+        run_perft(text, our_bb, their_bb, depth, PerftMode::Raw, false, 0, bulk, table_ptr, num_threads);
+        run_perft(text, our_bb, their_bb, depth, PerftMode::NonLosing, false, 0, bulk, table_ptr, num_threads);
+    }
+    else if (paths.empty()) paths.push_back(std::string(BENCH_DIR) + "/perft.txt");
+
+    for (const std::string & path : paths)
+    {
+        if (!run_file(path, bulk, table_ptr, num_threads, mismatches))
+        {
+            std::cerr << "Could not open " << path << '\n';
+            return EXIT_FAILURE;
+        }
+    }
+
+    return mismatches ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "bitboard.h"
+#include "constants.h"
+#include "search_helpers.h"
+#include "tt.h"
+
+#include <array>
+
+
+/// @brief A position seen from the player to move, with both sides' winning positions kept up to date
+/// as moves are played and undone, so that searching a child doesn't recompute them from scratch.
+/// @tparam G The board's geometry.
+template <class G>
+class BasicPosition
+{
+public:
+    using Board = typename G::Board;
+
+    /// @brief Create a position.
+    /// @param our_bb Our pieces (the player to move).
+    /// @param their_bb Our opponent's pieces.
+    BasicPosition(Board our_bb, Board their_bb)
+        : m_state{our_bb, their_bb, winning_positions<G>(our_bb, their_bb), winning_positions<G>(their_bb, our_bb)}
+    {
+    }
+
+    /// @brief Get our pieces.
+    Board our() const { return m_state.our; }
+
+    /// @brief Get our opponent's pieces.
+    Board their() const { return m_state.their; }
+
+    /// @brief Get the empty tiles where we would win by playing.
+    Board our_threats() const { return m_state.our_threats; }
+
+    /// @brief Get the empty tiles where our opponent would win by playing.
+    Board their_threats() const { return m_state.their_threats; }
+
+    /// @brief Get the number of moves played since the position was created.
+    int ply() const { return m_ply; }
+
+    /// @brief Get the position's TT key. make_key is a single addition, cheaper than keeping it up to date.
+    Board key() const { return make_key<G>(m_state.our, m_state.their); }
+
+    /// @brief Get our legal moves.
+    Board possible() const { return possible_moves<G>(m_state.our, m_state.their); }
+
+    /// @brief Get our moves which don't let our opponent win right away, as possible_non_losing_moves.
+    Board non_losing() const { return non_losing_moves<G>(possible(), m_state.their_threats); }
+
+    /// @brief Play a move on a file, which must not be full.
+    /// @param f The file, from 0.
+    void play(int f)
+    {
+        Board move = possible() & G::file(f);
+        play_move(move, winning_positions<G>(m_state.our | move, m_state.their));
+    }
+
+    /// @brief Play a move whose winning positions are already known, as sort_moves returns them.
+    /// @param move The move's square only.
+    /// @param mover_threats Our winning positions after the move.
+    void play_move(Board move, Board mover_threats)
+    {
+        m_stack[m_ply++] = m_state;
+
+        // the stone may fill one of our opponent's winning positions, it can't create any
+        m_state = State{m_state.their, m_state.our | move, m_state.their_threats & ~move, mover_threats};
+    }
+
+    /// @brief Take back the last move played.
+    void undo()
+    {
+        m_state = m_stack[--m_ply];
+    }
+
+private:
+    /// @brief Everything that changes with a move, saved on the stack so that undo is a copy.
+    struct State
+    {
+        Board our;
+        Board their;
+        Board our_threats;
+        Board their_threats;
+    };
+
+    State m_state;
+    std::array<State, G::NUM_STONES> m_stack; // the states before each move played
+    int m_ply = 0;
+};
+
+// a position on the standard board
+using Position = BasicPosition<StandardGeometry>;
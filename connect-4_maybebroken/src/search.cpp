@@ -1,111 +1,680 @@
 #include "search.h"
 
 #include "search_helpers.h"
-#include "display.h"
+#include "position.h"
+#include "threats.h"
+#include "sort_moves_simd.h"
 #include "tt.h"
+#include "book.h"
+#include "trace.h"
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <thread>
+#include <type_traits>
+#include <vector>
 
 
 
-// Used for checking moves from center outward.
-// Files D, C, E, F, B, A, G
-constexpr const Bitboard move_order[7] = {FileD_BB, FileC_BB, FileE_BB, FileF_BB, FileB_BB, FileA_BB, FileG_BB};
+/// @brief Get the files whose moves are the mirror images of moves on the files left of the center.
+/// @tparam G The board's geometry.
+template <class G>
+constexpr typename G::Board mirrored_files()
+{
+    typename G::Board files = 0;
+    for (int f = 0; f < G::WIDTH; ++f)
+    {
+        if (2*f > G::WIDTH - 1) files |= G::file(f);
+    }
+    return files;
+}
+
+// Files whose moves are the mirror images of moves on files A-C.
+constexpr Bitboard Mirrored_Files_BB = mirrored_files<StandardGeometry>();
+static_assert(Mirrored_Files_BB == (FileE_BB | FileF_BB | FileG_BB), "files E-G mirror files A-C");
 
 
 // See http://blog.gamesolver.org/solving-connect-four/01-introduction/ for info
 
 
+// number of threads used by root_search
+static int num_search_threads = DEFAULT_SEARCH_THREADS;
 
-int negamax(Bitboard our_bb, Bitboard their_bb, int depth_left, int alpha, int beta)
+// implementation of sort_moves used by searches
+static MoveSorter move_sorter = best_move_sorter();
+
+// whether negamax probes its children's TT entries before searching them
+static bool use_etc = ETC_DEFAULT;
+static bool use_threat_analysis = THREAT_ANALYSIS_DEFAULT;
+
+// whether root_search and find_best_move print their progress
+static bool verbose_search = true;
+
+// work done by the current thread's searches
+static thread_local SearchStats t_stats = {};
+
+// Per-thread search state, used by lazy SMP.
+// Set when the search on this thread must be abandoned (another thread finished first).
+static thread_local const std::atomic<bool> * t_stop = nullptr;
+// Move-order shuffling RNG state, 0 for the main (unshuffled) search.
+static thread_local uint_fast64_t t_rng = 0;
+
+// Per-thread search budget, used by root_search_budget.
+static thread_local bool t_budgeted = false;
+static thread_local std::chrono::steady_clock::time_point t_deadline;
+static thread_local uint64_t t_node_limit = 0; // in t_stats.nodes, 0 if unlimited
+// Set once the budget ran out, the search is then abandoned.
+static thread_local bool t_out_of_budget = false;
+
+/// @brief How the current thread's last node returned, for its trace record.
+struct TraceNodeExit
+{
+    TraceExit exit;
+    bool tt_hit;
+    int move_file; // TT_NO_MOVE if none
+    int move_index;
+};
+
+// Set by search_node right before returning, only when SEARCH_TRACE_ENABLED.
+static thread_local TraceNodeExit t_trace_exit;
+
+
+/// @brief Check whether the current thread's search was abandoned.
+/// @return Whether results computed from now on must be thrown away.
+static inline bool search_stopped()
+{
+    return t_out_of_budget || (t_stop && t_stop->load(std::memory_order_relaxed));
+}
+
+/// @brief Check the current thread's budget, flagging the search as abandoned if it ran out.
+static void check_budget()
+{
+    if ((t_node_limit && t_stats.nodes >= t_node_limit) || std::chrono::steady_clock::now() >= t_deadline)
+    {
+        t_out_of_budget = true;
+    }
+}
+
+/// @brief Get the transposition table of a board size's searches.
+/// @tparam G The board's geometry.
+/// @return The global table for the standard board, else one of TT_DEFAULT_SIZE_MB created on first use.
+template <class G>
+static inline BasicTranspositionTable<G> & table()
+{
+    if constexpr (std::is_same_v<G, StandardGeometry>) return tt;
+    else
+    {
+        static BasicTranspositionTable<G> variant_tt;
+        return variant_tt;
+    }
+}
+
+/// @brief Sort moves as sort_moves, with the implementation chosen by set_move_sorter on the standard board
+/// (the vector code assumes its size).
+/// @tparam G The board's geometry.
+template <class G>
+static inline BasicSortedMoves<G> sort_node_moves(typename G::Board our_bb, typename G::Board their_bb, typename G::Board possible)
+{
+    if constexpr (std::is_same_v<G, StandardGeometry>) return sort_moves_with(move_sorter, our_bb, their_bb, possible);
+    else return sort_moves<G>(our_bb, their_bb, possible);
+}
+
+/// @brief Sort our non-losing moves as sort_node_moves.
+/// @tparam G The board's geometry.
+template <class G>
+static inline BasicSortedMoves<G> sort_node_moves(typename G::Board our_bb, typename G::Board their_bb)
+{
+    return sort_node_moves<G>(our_bb, their_bb, possible_non_losing_moves<G>(our_bb, their_bb));
+}
+
+/// @brief Get the file of a move.
+/// @tparam G The board's geometry.
+/// @param move The move's square only.
+/// @return The file, from 0 (A).
+template <class G>
+static inline int move_file(typename G::Board move)
+{
+    return lsb_index<G>(move) / G::FILE_BITS;
+}
+
+/// @brief Save an entry into the transposition table, counting it in the current thread's statistics.
+/// @tparam G The board's geometry.
+/// @param our_bb Our pieces.
+/// @param their_bb Our opponent's pieces.
+/// @param upper_bound The upper bound of the position's value.
+/// @param lower_bound The lower bound of the position's value, TT_NO_LOWER_BOUND if none.
+/// @param move_file The file of the best or cut-off move, TT_NO_MOVE if none.
+template <class G>
+static inline void save_to_tt(typename G::Board our_bb, typename G::Board their_bb, int upper_bound, int lower_bound, int move_file)
+{
+    bool evicted = table<G>().save(our_bb, their_bb, upper_bound, lower_bound, move_file);
+
+    if constexpr (SEARCH_STATS_ENABLED)
+    {
+        ++t_stats.tt_stores;
+        if (evicted) ++t_stats.tt_overwrites;
+    }
+}
+
+/// @brief Search the move stored in the TT first, keeping the other moves' order.
+/// @param sorted The moves, as returned by sort_moves. Reordered in place.
+/// @param num_moves The number of moves.
+/// @param our_bb Our pieces.
+/// @param tt_move The file of the move stored in the TT, TT_NO_MOVE if none.
+template <class G>
+static inline void order_tt_move_first(std::array<BasicScoredMove<G>, G::WIDTH> & sorted, int num_moves, typename G::Board our_bb, int tt_move)
+{
+    if (tt_move == TT_NO_MOVE) return;
+
+    for (int i = 1; i < num_moves; ++i)
+    {
+        if (move_file<G>(sorted[i].move ^ our_bb) == tt_move)
+        {
+            std::rotate(sorted.begin(), sorted.begin() + i, sorted.begin() + i + 1);
+            return;
+        }
+    }
+}
+
+/// @brief Step the current thread's xorshift RNG.
+/// @return The next pseudo-random number.
+static inline uint_fast64_t next_random()
 {
-    auto tuple = sort_moves(our_bb, their_bb);
+    t_rng ^= t_rng << 13;
+    t_rng ^= t_rng >> 7;
+    t_rng ^= t_rng << 17;
+    return t_rng;
+}
+
 
-    auto [sorted, num_moves] = tuple;
 
-    if (num_moves == 0) return -depth_left; // loss/draw if no non-losing moves
+/// @brief Tell the search trace how the current node returns (nothing unless SEARCH_TRACE_ENABLED).
+static inline void trace_exit(TraceExit exit, bool tt_hit, int move_file = TT_NO_MOVE, int move_index = 0)
+{
+    if constexpr (SEARCH_TRACE_ENABLED) t_trace_exit = TraceNodeExit{exit, tt_hit, move_file, move_index};
+}
+
+template <class G>
+static int negamax(BasicPosition<G> & pos, int depth_left, int alpha, int beta);
+
+/// @brief The search of a negamax node, on a position which is played on and restored for the children.
+/// @tparam G The board's geometry.
+/// @param pos The position, unchanged on return.
+template <class G>
+static inline int search_node(BasicPosition<G> & pos, int depth_left, int alpha, int beta)
+{
+    using Board = typename G::Board;
+
+    static_assert(G::NUM_STONES <= MAX_BOARD_STONES && G::WIDTH <= MAX_BOARD_WIDTH,
+                  "search statistics are sized for the largest board");
+
+    ++t_stats.nodes;
+    if constexpr (SEARCH_STATS_ENABLED) ++t_stats.nodes_per_depth[depth_left];
+
+    // reading the clock is too slow for every node
+    if (t_budgeted && (t_stats.nodes & BUDGET_CHECK_MASK) == 0) check_budget();
+
+    const Board our_bb = pos.our();
+    const Board their_bb = pos.their();
+
+    // our opponent's winning positions are cached, so this needs no shifts
+    Board possible = pos.non_losing();
+
+    if (possible == Empty_BB) // loss/draw if no non-losing moves
+    {
+        trace_exit(TraceExit::NoMoves, false);
+        return -depth_left;
+    }
+
+    // start fetching the children's TT buckets, they are probed right after our own
+    for (Board moves = possible; moves; moves &= moves - 1)
+    {
+        table<G>().prefetch(their_bb, our_bb | (moves & -moves));
+    }
     
-    // get TT upper bound
-    int tt_val = tt.probe(our_bb, their_bb);
+    // get TT bounds, and the move which was best last time
+    int tt_move;
+    int tt_lower;
+    int tt_val = table<G>().probe(our_bb, their_bb, tt_lower, tt_move);
+
+    const bool tt_hit = tt_val != TT_NOT_FOUND;
+
+    ++t_stats.tt_probes;
+    if (tt_hit) ++t_stats.tt_hits;
 
     // our initial upper bound, as we can't win next
     // (wouldn't be a non-losing move at our parent node)
     int max = depth_left - 1;
 
     // don't forget to check if entry was not found
-    if (tt_val != TT_NOT_FOUND)
+    if (tt_hit)
     {
         // set max score to the tt's upper bound for the current position
         max = tt_val;
+
+        // a lower bound proven by an earlier cut-off: no need to search for less
+        if (tt_lower > alpha)
+        {
+            alpha = tt_lower;
+            if (alpha >= beta)
+            {
+                if constexpr (SEARCH_STATS_ENABLED) ++t_stats.tt_lower_cutoffs;
+                trace_exit(TraceExit::TTLower, true);
+                return alpha;
+            }
+        }
+    }
+
+    // zugzwang: our opponent's follow-up may prove we can't win, or lose
+    // (only worth its cost when it may prune)
+    if (use_threat_analysis && alpha >= THREAT_LOSS_BOUND && max > alpha)
+    {
+        int threat_bound = threat_upper_bound<G>(our_bb, their_bb, pos.their_threats());
+        if (threat_bound < max)
+        {
+            max = threat_bound;
+            if constexpr (SEARCH_STATS_ENABLED) if (max <= alpha) ++t_stats.threat_cutoffs;
+        }
     }
 
-    // early beta-pruning with the new lower bound
+    // early beta-pruning with the new lower bound, before paying for the children's threats
     if (max < beta)
     {
         beta = max; // no need to keep beta above our max possible score
-        if (alpha >= beta) return beta; // prune if [alpha; beta] window is empty
+        if (alpha >= beta) // prune if [alpha; beta] window is empty
+        {
+            if constexpr (SEARCH_STATS_ENABLED) ++t_stats.early_prunes;
+            trace_exit(TraceExit::Pruned, tt_hit);
+            return beta;
+        }
     }
+
+    // enhanced transposition cutoffs: a child's upper bound is a lower bound of our score through that move
+    // (their buckets were prefetched above)
+    if (use_etc)
+    {
+        for (Board moves = possible; moves; moves &= moves - 1)
+        {
+            int child_move;
+            int child_lower;
+            int child_val = table<G>().probe(their_bb, our_bb | (moves & -moves), child_lower, child_move);
+
+            ++t_stats.tt_probes;
+            if (child_val == TT_NOT_FOUND) continue;
+            ++t_stats.tt_hits;
+
+            if (-child_val >= beta)
+            {
+                if constexpr (SEARCH_STATS_ENABLED) ++t_stats.etc_cutoffs;
+                trace_exit(TraceExit::ETC, tt_hit, move_file<G>(moves & -moves));
+                return -child_val;
+            }
+        }
+    }
+
+    auto [sorted, num_moves] = sort_node_moves<G>(our_bb, their_bb, possible);
+
+    order_tt_move_first<G>(sorted, num_moves, our_bb, tt_move);
     
+    // lazy SMP helpers randomly perturb the move order so that threads explore different subtrees first
+    if (t_rng && num_moves > 1 && (next_random() & SMP_SHUFFLE_MASK) == 0)
+    {
+        std::swap(sorted[0], sorted[1]);
+    }
+
+    // the same rules from our opponent's side: a move after which they lose to our follow-up proves a win,
+    // before searching the moves ahead of it
+    if (use_threat_analysis && beta <= -THREAT_LOSS_BOUND)
+    {
+        for (int i = 0; i < num_moves; ++i)
+        {
+            if (threat_upper_bound<G>(their_bb, sorted[i].move, sorted[i].threats) == THREAT_LOSS_BOUND)
+            {
+                if constexpr (SEARCH_STATS_ENABLED) ++t_stats.threat_cutoffs;
+                trace_exit(TraceExit::Threat, tt_hit, move_file<G>(sorted[i].move ^ our_bb), i);
+                return -THREAT_LOSS_BOUND;
+            }
+        }
+    }
+
+    // the move which raised alpha, if any
+    int best_file = TT_NO_MOVE;
+    int best_index = 0;
+
     for (int i = 0; i < num_moves; ++i)
     {
-        /*
-        // isolate tentative move from legal moves in order
-        Bitboard tentative_move_only = non_losing_moves & move_order[file_index];
+        Board move_only = sorted[i].move ^ our_bb;
 
-        // if tentative move is nonexistent, continue
-        if (tentative_move_only == Empty_BB) continue;
+        // the child reuses the threats sort_moves computed for the move,
+        // negate and swap alpha, beta and the result
+        pos.play_move(move_only, sorted[i].threats);
+        int score = -negamax<G>(pos, depth_left-1, -beta, -alpha);
+        pos.undo();
+
+        // abandoned searches return garbage, don't let it reach the TT
+        if (search_stopped())
+        {
+            trace_exit(TraceExit::Stopped, tt_hit);
+            return 0;
+        }
 
-        // set other bits from our current BB
-        Bitboard tentative_move = (tentative_move_only | our_bb);
-        */
+        if (score >= beta) // beta cut-off
+        {
+            if constexpr (SEARCH_STATS_ENABLED) ++t_stats.cutoffs_by_move[i];
 
-        // "Our" new move becomes the child's adversary,
-        // our adversary's bitboard becomes our child's bitboard.
-        // Also negate and swap alpha, beta and the result
-        int score = -negamax(their_bb, sorted[i].move, depth_left-1, -beta, -alpha);
+            // remember the refutation, to try it first next time, and the lower bound it proves;
+            // our upper bound is unchanged
+            save_to_tt<G>(our_bb, their_bb, max, score, move_file<G>(move_only));
 
-        if (score >= beta) return score; // beta cut-off
+            trace_exit(TraceExit::Cutoff, tt_hit, move_file<G>(move_only), i);
+            return score;
+        }
         
         // tighten alpha bound for next iteration
-        if (score > alpha) alpha = score;
+        if (score > alpha)
+        {
+            alpha = score;
+            best_file = move_file<G>(move_only);
+            best_index = i;
+        }
     }
     
-    // store the new position upper bound
-    tt.save(our_bb, their_bb, alpha);
+    // store the new position upper bound, which is exact if a move raised alpha inside the window
+    save_to_tt<G>(our_bb, their_bb, alpha, best_file != TT_NO_MOVE ? alpha : TT_NO_LOWER_BOUND, best_file);
     
+    trace_exit(TraceExit::AllMoves, tt_hit, best_file, best_index);
     return alpha;
 }
 
-int root_search(Bitboard our_bb, Bitboard their_bb, bool weak)
+/// @brief negamax on a position, which is played on and restored for the children.
+/// Sampled nodes are recorded into the search trace when SEARCH_TRACE_ENABLED (its records only hold standard keys).
+/// @tparam G The board's geometry.
+/// @param pos The position, unchanged on return.
+template <class G>
+static int negamax(BasicPosition<G> & pos, int depth_left, int alpha, int beta)
 {
-    int depth_left = NUM_STONES - popcount(our_bb|their_bb);
-    
-    std::cout << "Depth left: " << depth_left << '\n';
+    if constexpr (SEARCH_TRACE_ENABLED && std::is_same_v<G, StandardGeometry>)
+    {
+        if (search_trace.sampled(depth_left, t_stats.nodes))
+        {
+            uint64_t nodes = t_stats.nodes;
+            int score = search_node<G>(pos, depth_left, alpha, beta);
+
+            // the children's records were written before, t_trace_exit is this node's again
+            const TraceNodeExit & node = t_trace_exit;
+            search_trace.record(TraceRecord::make(pos.key(), depth_left, alpha, beta, score, node.exit,
+                                                  node.move_file, node.move_index, node.tt_hit, t_stats.nodes - nodes));
+            return score;
+        }
+    }
+
+    return search_node<G>(pos, depth_left, alpha, beta);
+}
+
+template <class G>
+int negamax(typename G::Board our_bb, typename G::Board their_bb, int depth_left, int alpha, int beta)
+{
+    BasicPosition<G> pos(our_bb, their_bb);
+    return negamax<G>(pos, depth_left, alpha, beta);
+}
+
+int negamax(Bitboard our_bb, Bitboard their_bb, int depth_left, int alpha, int beta)
+{
+    return negamax<StandardGeometry>(our_bb, their_bb, depth_left, alpha, beta);
+}
+
+/// @brief Negamax at the root node, also reporting which move the score comes from.
+/// @tparam G The board's geometry.
+/// @param best_move Receives the move (square only) which raised alpha or caused the cut-off,
+/// else the first move searched. Empty_BB if there are no non-losing moves.
+/// @return The same as negamax.
+template <class G>
+static int root_negamax(typename G::Board our_bb, typename G::Board their_bb, int depth_left, int alpha, int beta,
+                        typename G::Board & best_move)
+{
+    auto [sorted, num_moves] = sort_node_moves<G>(our_bb, their_bb);
+
+    best_move = Empty_BB;
+
+    // nothing to choose from
+    if (num_moves == 0) return negamax<G>(our_bb, their_bb, depth_left, alpha, beta);
+
+    // in a symmetric position, moves right of the center are worth the same as their mirror images
+    if (is_symmetric<G>(our_bb, their_bb))
+    {
+        num_moves = std::remove_if(sorted.begin(), sorted.begin() + num_moves, [&](const BasicScoredMove<G> & m)
+                    {
+                        return ((m.move ^ our_bb) & mirrored_files<G>()) != Empty_BB;
+                    }) - sorted.begin();
+    }
+
+    ++t_stats.nodes;
+    if constexpr (SEARCH_STATS_ENABLED) ++t_stats.nodes_per_depth[depth_left];
+
+    // lazy SMP helpers randomly perturb the move order so that threads explore different subtrees first
+    if (t_rng && num_moves > 1 && (next_random() & SMP_SHUFFLE_MASK) == 0)
+    {
+        std::swap(sorted[0], sorted[1]);
+    }
+
+    best_move = sorted[0].move ^ our_bb;
+
+    for (int i = 0; i < num_moves; ++i)
+    {
+        int score = -negamax<G>(their_bb, sorted[i].move, depth_left-1, -beta, -alpha);
+
+        // abandoned searches return garbage
+        if (search_stopped()) return 0;
+
+        if (score >= beta) // beta cut-off
+        {
+            if constexpr (SEARCH_STATS_ENABLED) ++t_stats.cutoffs_by_move[i];
+            best_move = sorted[i].move ^ our_bb;
+            return score;
+        }
+
+        if (score > alpha)
+        {
+            alpha = score;
+            best_move = sorted[i].move ^ our_bb;
+        }
+    }
+
+    return alpha;
+}
+
+/// @brief Run root_negamax on all search threads (lazy SMP), sharing the board size's transposition table.
+/// Every thread searches the same node with the same window; the first one to finish gives the result.
+/// @tparam G The board's geometry.
+/// @param best_move Receives the best move, as for root_negamax.
+/// @param completed Receives whether a thread finished, false if the current thread's budget ran out first.
+/// @return The same as negamax, meaningless if the search wasn't completed.
+template <class G>
+static int parallel_negamax(typename G::Board our_bb, typename G::Board their_bb, int depth_left, int alpha, int beta,
+                            typename G::Board & best_move, bool & completed)
+{
+    using Board = typename G::Board;
+
+    if (num_search_threads <= 1)
+    {
+        int score = root_negamax<G>(our_bb, their_bb, depth_left, alpha, beta, best_move);
+        completed = !search_stopped();
+        return score;
+    }
+
+    std::atomic<bool> stop{false};
+    std::atomic<bool> done{false};
+    std::vector<SearchStats> helper_stats(num_search_threads, SearchStats{});
+    int result = 0;
+    Board result_move = Empty_BB;
+
+    auto search = [&](int thread_id)
+    {
+        t_stop = &stop;
+        // thread 0 keeps the regular move order
+        t_rng = thread_id ? RNG_SEED + thread_id : 0;
+
+        Board move;
+        int score = root_negamax<G>(our_bb, their_bb, depth_left, alpha, beta, move);
+
+        // only the first finisher publishes its score, then everyone else stops
+        if (!search_stopped() && !done.exchange(true))
+        {
+            result = score;
+            result_move = move;
+        }
+
+        // also stops the helpers when the budget (only checked by thread 0) runs out
+        stop.store(true, std::memory_order_relaxed);
+
+        t_stop = nullptr;
+        t_rng = 0;
+
+        // the caller's statistics include its helpers' work
+        if (thread_id) helper_stats[thread_id] = t_stats;
+    };
+
+    std::vector<std::thread> helpers;
+    for (int thread_id = 1; thread_id < num_search_threads; ++thread_id)
+    {
+        helpers.emplace_back(search, thread_id);
+    }
+
+    search(0);
+
+    for (auto & helper : helpers) helper.join();
+
+    for (const SearchStats & stats : helper_stats) t_stats += stats;
+
+    best_move = result_move;
+    completed = done;
+    return result;
+}
+
+void set_search_threads(int num_threads)
+{
+    num_search_threads = std::max(1, num_threads);
+}
+
+bool set_move_sorter(MoveSorter sorter)
+{
+    if (!move_sorter_supported(sorter)) return false;
+
+    move_sorter = sorter;
+    return true;
+}
+
+MoveSorter get_move_sorter()
+{
+    return move_sorter;
+}
+
+void set_enhanced_transposition_cutoffs(bool enabled)
+{
+    use_etc = enabled;
+}
+
+void set_threat_analysis(bool enabled)
+{
+    use_threat_analysis = enabled;
+}
+
+void set_search_verbose(bool verbose)
+{
+    verbose_search = verbose;
+}
+
+const SearchStats & search_stats()
+{
+    return t_stats;
+}
+
+void reset_search_stats()
+{
+    t_stats = SearchStats{};
+}
+
+/// @brief Probe the opening book for a root node and its children.
+/// @param our_bb Our pieces.
+/// @param their_bb Our opponent's pieces.
+/// @param possible Our legal moves.
+/// @param result Receives the position's score, and the move leading to the best child if they are all in the book.
+/// @return Whether the position is in the book.
+static bool probe_book(Bitboard our_bb, Bitboard their_bb, Bitboard possible, SearchResult & result)
+{
+    int book_val = book.probe(our_bb, their_bb);
+    if (book_val == TT_NOT_FOUND) return false;
+
+    // the best move is the one leading to the best child in the book, if they are all there
+    Bitboard best_move = Empty_BB;
+    int best_val = INT_MIN;
+
+    for (Bitboard moves = possible; moves; moves &= moves - 1)
+    {
+        int child_val = book.probe(their_bb, our_bb | (moves & -moves));
+
+        if (child_val == TT_NOT_FOUND)
+        {
+            best_move = Empty_BB;
+            break;
+        }
+
+        if (-child_val > best_val)
+        {
+            best_val = -child_val;
+            best_move = moves & -moves;
+        }
+    }
+
+    result = SearchResult{book_val, book_val, best_move};
+    return true;
+}
+
+/// @brief Narrow the score of a root node with null window searches, until it is exact or the thread's budget runs out.
+/// Wins in one and positions of the opening book (on the standard board) are answered without searching.
+/// @tparam G The board's geometry.
+/// @param min A lower bound of the score.
+/// @param max An upper bound of the score.
+/// @param alpha Stop once the score is proven to be at most alpha.
+/// @param beta Stop once the score is proven to be at least beta.
+/// @return The proven score interval and best move.
+template <class G>
+static BasicSearchResult<G> solve_root(typename G::Board our_bb, typename G::Board their_bb, int min, int max,
+                                       int alpha = INT_MIN, int beta = INT_MAX)
+{
+    using Board = typename G::Board;
+
+    int depth_left = G::NUM_STONES - popcount<G>(our_bb|their_bb);
     
     // check if we can win in one, as negamax function doesn't handle this case.
-    Bitboard possible = possible_moves(our_bb, their_bb);
+    Board possible = possible_moves<G>(our_bb, their_bb);
     
-    if (possible == Empty_BB) return 0; // draw
-    while (possible)
+    if (possible == Empty_BB) return BasicSearchResult<G>{0, 0, Empty_BB}; // draw
+    for (Board moves = possible; moves; )
     {
-        Bitboard move = possible & -possible; // isolate LS set bit
-        possible ^= move; // clear the move from possible moves
+        Board move = moves & -moves; // isolate LS set bit
+        moves ^= move; // clear the move from possible moves
         
-        // check if we win
-        if (check_win(our_bb|move)) return depth_left;
+        // check if we win (same scale as negamax: one more than the empty squares before the winning stone)
+        if (check_win<G>(our_bb|move)) return BasicSearchResult<G>{depth_left + 1, depth_left + 1, move};
     }
 
-    // worst we can have is opposite the number of squares left minus 1 (we play before)
-    // if weak search, use null window instead
-    int min = weak ? -1 : (-depth_left - 1);
+    // shallow positions are answered straight from the opening book, if one is loaded
+    if constexpr (std::is_same_v<G, StandardGeometry>)
+    {
+        SearchResult book_result;
+        if (probe_book(our_bb, their_bb, possible, book_result)) return book_result;
+    }
 
-    // best we can have is the number of squares left
-    // if weak search, use null window instead
-    int max = weak ? 1 : depth_left;
+    // the move from the last search which proved a new lower bound, else the first move tried
+    Board best_move = Empty_BB;
     
     // iteratively narrow the search window, doing a sort-of binary search
     // end when the window is empty
-    while (min < max)
+    // or once it is known to be outside ]alpha; beta[
+    while (min < max && max > alpha && min < beta)
     {
         // round difference between bounds AWAY from 0
         int mdp = min + (max-min)/2;
@@ -115,19 +684,303 @@ int root_search(Bitboard our_bb, Bitboard their_bb, bool weak)
         if(mdp <= 0 && min/2 < mdp) mdp = min/2;
         else if(mdp >= 0 && max/2 > mdp) mdp = max/2;
 
-        int score = negamax(our_bb, their_bb, depth_left, mdp, mdp+1);   // use a null depth window to know if the actual score is greater or smaller than med
+        // test the window's bounds first, either may end the search
+        mdp = std::clamp(mdp, std::max(min, alpha), std::min(max, beta) - 1);
+
+        Board move;
+        bool completed;
+        int score = parallel_negamax<G>(our_bb, their_bb, depth_left, mdp, mdp+1, move, completed);   // use a null depth window to know if the actual score is greater or smaller than med
+
+        // out of budget: keep the bounds proven so far
+        if (!completed) break;
+
+        if constexpr (SEARCH_STATS_ENABLED) ++t_stats.null_window_iterations;
         
         // if the score is worse than midpoint, make it our new max
         // if it is equal/better, make it our new min
-        if(score <= mdp) max = score;
-        else min = score;
+        if(score <= mdp)
+        {
+            max = score;
+            if (best_move == Empty_BB) best_move = move;
+        }
+        else
+        {
+            min = score;
+            best_move = move;
+        }
     }
     
-    return min; // the final minimum is our position's score
+    // nothing searched to completion: fall back to the move ordering's favourite
+    if (best_move == Empty_BB)
+    {
+        auto [sorted, num_moves] = sort_node_moves<G>(our_bb, their_bb);
+        best_move = num_moves ? (sorted[0].move ^ our_bb) : (possible & -possible);
+    }
+    
+    return BasicSearchResult<G>{min, max, best_move}; // the final minimum is our position's score
+}
+
+/// @brief Search a root node from scratch.
+/// @tparam G The board's geometry.
+/// @param weak Whether to only search for the sign of the score.
+/// @return The proven score interval and best move.
+template <class G>
+static BasicSearchResult<G> search_root(typename G::Board our_bb, typename G::Board their_bb, bool weak)
+{
+    int depth_left = G::NUM_STONES - popcount<G>(our_bb|their_bb);
+    
+    if (verbose_search) std::cout << "Depth left: " << depth_left << '\n';
+
+    // worst we can have is opposite the number of squares left minus 1 (we play before)
+    // if weak search, use null window instead
+    int min = weak ? -1 : (-depth_left - 1);
+
+    // best we can have is the number of squares left
+    // if weak search, use null window instead
+    int max = weak ? 1 : depth_left;
+
+    return solve_root<G>(our_bb, their_bb, min, max);
+}
+
+template <class G>
+int root_search(typename G::Board our_bb, typename G::Board their_bb, bool weak)
+{
+    return search_root<G>(our_bb, their_bb, weak).min;
+}
+
+int root_search(Bitboard our_bb, Bitboard their_bb, bool weak)
+{
+    return root_search<StandardGeometry>(our_bb, their_bb, weak);
+}
+
+SearchResult root_search_window(Bitboard our_bb, Bitboard their_bb, int alpha, int beta)
+{
+    int depth_left = NUM_STONES - popcount(our_bb|their_bb);
+
+    return solve_root<StandardGeometry>(our_bb, their_bb, -depth_left - 1, depth_left, alpha, beta);
+}
+
+template <class G>
+BasicSearchResult<G> root_search_budget(typename G::Board our_bb, typename G::Board their_bb, double max_seconds, uint64_t max_nodes)
+{
+    t_budgeted = max_seconds > 0.0 || max_nodes > 0;
+    t_out_of_budget = false;
+
+    // no time limit: a deadline which never comes
+    t_deadline = (max_seconds > 0.0)
+               ? std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                                        std::chrono::duration<double>(max_seconds))
+               : std::chrono::steady_clock::time_point::max();
+    t_node_limit = max_nodes ? t_stats.nodes + max_nodes : 0;
+
+    BasicSearchResult<G> result = search_root<G>(our_bb, their_bb, false);
+
+    t_budgeted = false;
+    t_out_of_budget = false;
+
+    return result;
+}
+
+SearchResult root_search_budget(Bitboard our_bb, Bitboard their_bb, double max_seconds, uint64_t max_nodes)
+{
+    return root_search_budget<StandardGeometry>(our_bb, their_bb, max_seconds, max_nodes);
+}
+
+/// @brief Prove whether a root node's score is above a bound, with a single null window search.
+/// Positions of the opening book are answered without searching. We must not be able to win in one.
+/// @param bound The bound.
+/// @param proven Receives a bound of the score: a lower bound above bound if the score is above it, else an upper bound.
+/// @return Whether the score is above bound.
+static bool score_above(Bitboard our_bb, Bitboard their_bb, int bound, int & proven)
+{
+    int book_val = book.probe(our_bb, their_bb);
+    if (book_val != TT_NOT_FOUND)
+    {
+        proven = book_val;
+        return book_val > bound;
+    }
+
+    Bitboard move;
+    bool completed;
+    proven = parallel_negamax<StandardGeometry>(our_bb, their_bb, NUM_STONES - popcount(our_bb|their_bb), bound, bound + 1, move, completed);
+    return proven > bound;
+}
+
+/// @brief Find a move keeping a root node's score, once it is known.
+/// @param value The node's exact score.
+/// @return The move's square, Empty_BB if there is no legal move.
+static Bitboard pv_move(Bitboard our_bb, Bitboard their_bb, int value)
+{
+    Bitboard possible = possible_moves(our_bb, their_bb);
+
+    // a win in one is as good as it gets
+    for (Bitboard moves = possible; moves; moves &= moves - 1)
+    {
+        if (check_win(our_bb | (moves & -moves))) return moves & -moves;
+    }
+
+    auto [sorted, num_moves] = sort_moves_with(move_sorter, our_bb, their_bb);
+
+    // every move loses at once: any of them will do
+    if (num_moves == 0)
+    {
+        for (Bitboard file : move_order)
+        {
+            if (possible & file) return possible & file;
+        }
+        return Empty_BB;
+    }
+
+    // our score is the best child's, negated: find a child scoring no more than -value
+    for (int i = 0; i < num_moves - 1; ++i)
+    {
+        int proven;
+        if (!score_above(their_bb, sorted[i].move, -value, proven)) return sorted[i].move ^ our_bb;
+    }
+
+    // no need to search the last one
+    return sorted[num_moves-1].move ^ our_bb;
+}
+
+PositionAnalysis analyze_position(Bitboard our_bb, Bitboard their_bb, bool exact_columns, bool with_pv)
+{
+    PositionAnalysis analysis{};
+    analysis.best_move = Empty_BB;
+
+    int depth_left = NUM_STONES - popcount(our_bb|their_bb);
+
+    Bitboard possible = possible_moves(our_bb, their_bb);
+    Bitboard non_losing = possible_non_losing_moves(our_bb, their_bb);
+
+    // in a symmetric position, moves on files E-G are worth the same as their mirror images
+    bool symmetric = is_symmetric(our_bb, their_bb);
+    Bitboard to_search = symmetric ? (possible & ~Mirrored_Files_BB) : possible;
+
+    // moves in search order: wins in one, the non-losing moves from the most promising, then the moves losing at once
+    Bitboard ordered[7];
+    int num_ordered = 0;
+
+    for (Bitboard file : move_order)
+    {
+        if ((to_search & file) && check_win(our_bb | (to_search & file))) ordered[num_ordered++] = to_search & file;
+    }
+
+    auto [sorted, num_moves] = sort_moves_with(move_sorter, our_bb, their_bb);
+    for (int i = 0; i < num_moves; ++i)
+    {
+        Bitboard move = sorted[i].move ^ our_bb;
+        if ((move & to_search) && !check_win(sorted[i].move)) ordered[num_ordered++] = move;
+    }
+
+    for (Bitboard file : move_order)
+    {
+        if (to_search & file & ~non_losing && !check_win(our_bb | (to_search & file))) ordered[num_ordered++] = to_search & file;
+    }
+
+    // the best exact score so far
+    int best = INT_MIN;
+
+    for (int i = 0; i < num_ordered; ++i)
+    {
+        Bitboard move = ordered[i];
+        Bitboard child = our_bb | move;
+
+        ColumnAnalysis & column = analysis.columns[move_file<StandardGeometry>(move)];
+        column.legal = true;
+
+        if (check_win(child))
+        {
+            // same scale as negamax: one more than the empty squares before the winning stone
+            column.min = column.max = depth_left + 1;
+        }
+        else if (!(move & non_losing))
+        {
+            // our opponent wins next
+            column.min = column.max = -depth_left;
+        }
+        else
+        {
+            // the child's score is within [-depth_left; depth_left - 1], as for any root search
+            column.min = -(depth_left - 1);
+            column.max = depth_left;
+
+            if (exact_columns || best == INT_MIN)
+            {
+                column.min = column.max = -solve_root<StandardGeometry>(their_bb, child, -depth_left, depth_left - 1).min;
+            }
+            else if (best < depth_left - 1) // else we can't win sooner than the best move already does
+            {
+                // only search for the exact score if the move does better than the best one so far
+                int proven;
+                if (score_above(their_bb, child, -best - 1, proven)) column.max = -proven;
+                else column.min = column.max = -solve_root<StandardGeometry>(their_bb, child, -depth_left, proven).min;
+            }
+            else column.max = depth_left - 1;
+        }
+
+        if (column.min == column.max && column.min > best)
+        {
+            best = column.min;
+            analysis.best_move = move;
+        }
+    }
+
+    if (symmetric)
+    {
+        for (int file = File_E; file <= File_G; ++file) analysis.columns[file] = analysis.columns[File_G - file];
+    }
+
+    // no legal move: the board is full, a draw
+    analysis.score = (best == INT_MIN) ? 0 : best;
+
+    if (with_pv && analysis.best_move != Empty_BB)
+    {
+        Bitboard move = analysis.best_move;
+        int value = analysis.score;
+
+        while (true)
+        {
+            analysis.pv.push_back(move);
+
+            // the game ends with a win or a full board
+            Bitboard played = our_bb | move;
+            if (check_win(played) || (played | their_bb) == All_Tiles_BB) break;
+
+            // our opponent's turn: their score is the opposite of ours
+            our_bb = their_bb;
+            their_bb = played;
+            value = -value;
+
+            move = pv_move(our_bb, their_bb, value);
+        }
+    }
+
+    return analysis;
 }
 
 int find_best_move(Bitboard our_bb, Bitboard their_bb, Bitboard & best_move, bool weak)
 {
+    if (!weak)
+    {
+        PositionAnalysis analysis = analyze_position(our_bb, their_bb, false, false);
+        best_move = analysis.best_move;
+
+        if (verbose_search)
+        {
+            for (int file = File_A; file <= File_G; ++file)
+            {
+                const ColumnAnalysis & column = analysis.columns[file];
+                if (!column.legal) continue;
+
+                std::cout << "Column " << file + 1 << ": ";
+                if (column.min == column.max) std::cout << column.min << '\n';
+                else std::cout << "[" << column.min << "; " << column.max << "]\n";
+            }
+        }
+
+        return analysis.score;
+    }
+
     best_move = Empty_BB; // initialize best move to an empty move
 
     Bitboard possible = possible_moves(our_bb, their_bb);
@@ -139,6 +992,9 @@ int find_best_move(Bitboard our_bb, Bitboard their_bb, Bitboard & best_move, boo
 
     int depth_left = NUM_STONES - popcount(our_bb|their_bb);
 
+    // in a symmetric position, moves on files E-G are worth the same as their mirror images
+    if (is_symmetric(our_bb, their_bb)) possible &= ~Mirrored_Files_BB;
+
     for (int col_index = 0; col_index < 7; ++col_index)
     {
         // isolate tentative move from legal moves in order
@@ -151,7 +1007,8 @@ int find_best_move(Bitboard our_bb, Bitboard their_bb, Bitboard & best_move, boo
 
         // compute the value of the new position for our adversary
         // and invert it to get our value (zero-sum game)
-        int tentative_value = -root_search(their_bb, tentative_move, weak);
+        // root_search doesn't check whether the side that just played has won, so do it here
+        int tentative_value = check_win(tentative_move) ? depth_left + 1 : -root_search(their_bb, tentative_move, weak);
 
         if (tentative_value > value) // if better than other moves
         {
@@ -159,28 +1016,26 @@ int find_best_move(Bitboard our_bb, Bitboard their_bb, Bitboard & best_move, boo
             best_move = tentative_move_only;
         }
 
-        std::cout << "For move\n";
-        display_bitboard(tentative_move_only);
-        std::cout << "at root level with depth " << depth_left << ", score is " << tentative_value << "\n\n";
+        if (verbose_search) std::cout << "Column " << square_file(bb_square(tentative_move_only)) + 1 << ": " << tentative_value << '\n';
     }
     
     return value;
 }
 
-/*
-int root_search_deepening(Bitboard our_bb, Bitboard their_bb, int max_depth, Bitboard & best_move)
-{
-    for (int depth = 1; depth <= max_depth; ++depth)
-    {
-        // Get value at a given depth, thereby setting best_move.
-        int value = root_search(our_bb, their_bb, best_move);
-        
-        std::cout << "Depth " << depth << ": value " << value << '\n';
 
-        // If a win for either player was found at a given depth, no need to go deeper.
-        if (value != 0) return value;
-    }
-    // If nothing was found (draw at max depth), return 0 (draw)
-    return 0;
-}
-*/
\ No newline at end of file
+// the other board sizes the solver is built for, with their transposition tables (see tt.cpp)
+template int negamax<BoardGeometry<6, 5>>(BoardGeometry<6, 5>::Board, BoardGeometry<6, 5>::Board, int, int, int);
+template int root_search<BoardGeometry<6, 5>>(BoardGeometry<6, 5>::Board, BoardGeometry<6, 5>::Board, bool);
+template BasicSearchResult<BoardGeometry<6, 5>> root_search_budget<BoardGeometry<6, 5>>(BoardGeometry<6, 5>::Board, BoardGeometry<6, 5>::Board, double, uint64_t);
+template int negamax<BoardGeometry<5, 4>>(BoardGeometry<5, 4>::Board, BoardGeometry<5, 4>::Board, int, int, int);
+template int root_search<BoardGeometry<5, 4>>(BoardGeometry<5, 4>::Board, BoardGeometry<5, 4>::Board, bool);
+template BasicSearchResult<BoardGeometry<5, 4>> root_search_budget<BoardGeometry<5, 4>>(BoardGeometry<5, 4>::Board, BoardGeometry<5, 4>::Board, double, uint64_t);
+template int negamax<BoardGeometry<4, 4>>(BoardGeometry<4, 4>::Board, BoardGeometry<4, 4>::Board, int, int, int);
+template int root_search<BoardGeometry<4, 4>>(BoardGeometry<4, 4>::Board, BoardGeometry<4, 4>::Board, bool);
+template BasicSearchResult<BoardGeometry<4, 4>> root_search_budget<BoardGeometry<4, 4>>(BoardGeometry<4, 4>::Board, BoardGeometry<4, 4>::Board, double, uint64_t);
+template int negamax<BoardGeometry<8, 7>>(BoardGeometry<8, 7>::Board, BoardGeometry<8, 7>::Board, int, int, int);
+template int root_search<BoardGeometry<8, 7>>(BoardGeometry<8, 7>::Board, BoardGeometry<8, 7>::Board, bool);
+template BasicSearchResult<BoardGeometry<8, 7>> root_search_budget<BoardGeometry<8, 7>>(BoardGeometry<8, 7>::Board, BoardGeometry<8, 7>::Board, double, uint64_t);
+template int negamax<BoardGeometry<9, 7>>(BoardGeometry<9, 7>::Board, BoardGeometry<9, 7>::Board, int, int, int);
+template int root_search<BoardGeometry<9, 7>>(BoardGeometry<9, 7>::Board, BoardGeometry<9, 7>::Board, bool);
+template BasicSearchResult<BoardGeometry<9, 7>> root_search_budget<BoardGeometry<9, 7>>(BoardGeometry<9, 7>::Board, BoardGeometry<9, 7>::Board, double, uint64_t);
@@ -1,6 +1,10 @@
 #pragma once
 
 #include "bitboard.h"
+#include "sort_moves_simd.h"
+#include "stats.h"
+
+#include <vector>
 
 /// @brief Calculates alpha-beta value for max (red) player.
 /// @param current_hash Zobrist hash upon function entry
@@ -15,20 +19,140 @@
 /// - if alpha <= actual score <= beta then return value = actual score;
 int negamax(Bitboard our_bb, Bitboard their_bb, int depth, int alpha, int beta);
 
+/// @brief negamax on a board of another size. The solver is built for 9x7, 8x7, 6x5, 5x4 and 4x4 boards besides
+/// the standard one (see the explicit instantiations in search.cpp); their searches have their own transposition
+/// table of TT_DEFAULT_SIZE_MB, created on first use (with wide entries on 8x7 and 9x7, see tt.h), and always sort
+/// moves with the portable sort_moves.
+/// @tparam G The board's geometry.
+template <class G>
+int negamax(typename G::Board our_bb, typename G::Board their_bb, int depth, int alpha, int beta);
+
+/// @brief Set the number of threads used by root_search and find_best_move.
+/// With more than one thread, helpers search the same root with perturbed move orders (lazy SMP),
+/// sharing the global transposition table.
+/// @param num_threads The number of threads, at least 1.
+void set_search_threads(int num_threads);
+
+/// @brief Choose the implementation of sort_moves used by searches (by default, best_move_sorter()).
+/// They all order moves the same way, so only the speed of searches changes.
+/// @param sorter The implementation.
+/// @return Whether the CPU supports it. If not, the implementation used is unchanged.
+bool set_move_sorter(MoveSorter sorter);
+
+/// @brief Get the implementation of sort_moves used by searches.
+/// @return The implementation.
+MoveSorter get_move_sorter();
+
+/// @brief Enable or disable enhanced transposition cutoffs (enabled by default): before searching a node's moves,
+/// probe the transposition table for each child, and return right away if a child's upper bound proves a beta cut-off.
+/// Scores are the same either way; only the number of nodes and TT probes changes.
+/// @param enabled Whether negamax probes its children.
+void set_enhanced_transposition_cutoffs(bool enabled);
+
+/// @brief Enable or disable threat analysis (enabled by default): before searching a node's moves, negamax applies
+/// the zugzwang rules of threat_upper_bound to it and to its children, and returns right away if they prove
+/// a fail-low or a fail-high.
+/// Scores are the same either way; only the number of nodes changes.
+/// @param enabled Whether negamax applies them.
+void set_threat_analysis(bool enabled);
+
+/// @brief Enable or disable progress output from root_search and find_best_move (enabled by default).
+/// @param verbose Whether to print progress to std::cout.
+void set_search_verbose(bool verbose);
+
+/// @brief Get the statistics of the current thread's searches (negamax, root_search and find_best_move),
+/// including the work of their lazy SMP helpers.
+/// @return The statistics since the last reset.
+const SearchStats & search_stats();
+
+/// @brief Reset the current thread's search statistics.
+void reset_search_stats();
+
 /// @brief Calculates value and best move at a root node.
-/// The transposition table must be cleared if the previous node search was not a direct sibling of the current position.
+/// Unless weak, this is analyze_position without exact scores for the other moves nor principal variation.
 /// @param our_bb Our pieces.
 /// @param their_bb Our opponent's pieces.
 /// @param best_move This bitboard, passed by reference, receives the best move found.
 /// @param weak Whether to perform a null window search to speed up the search (returns a non-optimal move).
 /// @return Returns the value for the position (value > 0 means we win, value == 0 means draw, value < 0 means we lose).
-/// abs(value) + 1 is the number of stones left.
+/// abs(value) - 1 is the number of empty squares left when the winning stone is played.
 int find_best_move(Bitboard our_bb, Bitboard their_bb, Bitboard & best_move, bool weak);
 
 /// @brief Calculates value of a given root node.
-/// The transposition table must be cleared if the previous node search was not a direct sibling of the current position.
+/// The opening book is probed first; negamax is only called for positions it doesn't contain.
 /// @param our_bb Our pieces.
 /// @param their_bb Our opponent's pieces.
 /// @param weak Whether to perform a null window search to speed up the search (returns a non-optimal move).
-/// @return 
-int root_search(Bitboard our_bb, Bitboard their_bb, bool weak);
\ No newline at end of file
+/// @return Returns the value for the position, on the same scale as find_best_move.
+int root_search(Bitboard our_bb, Bitboard their_bb, bool weak);
+
+/// @brief root_search on a board of another size (see negamax<G>). The opening book only holds standard positions,
+/// so it isn't probed.
+/// @tparam G The board's geometry.
+template <class G>
+int root_search(typename G::Board our_bb, typename G::Board their_bb, bool weak);
+
+/// @brief Outcome of a root search which may have been stopped early.
+/// @tparam G The board's geometry.
+template <class G>
+struct BasicSearchResult
+{
+    int min; // proven lower bound of the score
+    int max; // proven upper bound of the score, equal to min once the score is exact
+    typename G::Board best_move; // square of the move found to reach min (or of the most promising move if none was proven),
+                                 // Empty_BB if there is no legal move or the score came from a partial opening book
+};
+
+// outcome of a root search on the standard board
+using SearchResult = BasicSearchResult<StandardGeometry>;
+
+/// @brief Calculates value of a given root node like root_search, but stops once a time or node budget runs out.
+/// Budgets are checked every few thousand nodes, so they may be exceeded by a little.
+/// @param our_bb Our pieces.
+/// @param their_bb Our opponent's pieces.
+/// @param max_seconds Time budget in seconds, 0 for none.
+/// @param max_nodes Node budget, 0 for none.
+/// @return The tightest score interval proven within the budget, and the best move found so far.
+SearchResult root_search_budget(Bitboard our_bb, Bitboard their_bb, double max_seconds, uint64_t max_nodes);
+
+/// @brief root_search_budget on a board of another size (see root_search<G>).
+/// @tparam G The board's geometry.
+template <class G>
+BasicSearchResult<G> root_search_budget(typename G::Board our_bb, typename G::Board their_bb, double max_seconds, uint64_t max_nodes);
+
+/// @brief Calculates value of a given root node like root_search, but only as precisely as needed to place it
+/// relative to ]alpha; beta[: the score is exact if it lies inside, else only proven to be at most alpha or at least beta.
+/// Nothing is printed.
+/// @param our_bb Our pieces.
+/// @param their_bb Our opponent's pieces.
+/// @param alpha The window's lower end, alpha < beta.
+/// @param beta The window's upper end.
+/// @return The proven score interval and best move.
+SearchResult root_search_window(Bitboard our_bb, Bitboard their_bb, int alpha, int beta);
+
+/// @brief What is known of the score of playing in one column.
+struct ColumnAnalysis
+{
+    bool legal; // whether the column has room for a stone, the bounds being meaningless otherwise
+    int min; // proven lower bound of the score after playing there
+    int max; // proven upper bound, equal to min once the score is exact
+};
+
+/// @brief Result of analyze_position.
+struct PositionAnalysis
+{
+    int score; // exact score of the position, on the same scale as root_search
+    Bitboard best_move; // square of a move reaching that score, Empty_BB if there is no legal move
+    ColumnAnalysis columns[7]; // by file, from A to G
+    std::vector<Bitboard> pv; // squares of the moves played from the position on with best play (principal variation)
+};
+
+/// @brief Calculates the score of every move of a root node in one pass, and the principal variation.
+/// Once a best move is known, the others are only searched to prove whether they do better, unless exact scores are asked for.
+/// The children share the transposition table, so they reuse each other's work. Nothing is printed.
+/// @param our_bb Our pieces.
+/// @param their_bb Our opponent's pieces.
+/// @param exact_columns Whether every column's score must be exact; else, columns which aren't best may only get an upper bound.
+/// @param with_pv Whether to extract the principal variation.
+/// @return The analysis.
+PositionAnalysis analyze_position(Bitboard our_bb, Bitboard their_bb, bool exact_columns, bool with_pv);
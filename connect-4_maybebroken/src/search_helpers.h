@@ -1,19 +1,66 @@
+#pragma once
+
 #include "bitboard.h"
 
 #include <array>
+#include <type_traits>
 #include <utility> // std::pair
 
 
+/// @brief Order files from the center outward, the left one first between files as far from the center.
+/// @tparam G The board's geometry.
+/// @return The files' bitboards.
+template <class G>
+constexpr std::array<typename G::Board, G::WIDTH> center_out_files()
+{
+    std::array<typename G::Board, G::WIDTH> files{};
+
+    // twice the distance from the center, in file widths
+    int i = 0;
+    for (int distance = (G::WIDTH + 1) % 2; distance < G::WIDTH; distance += 2)
+    {
+        for (int f = 0; f < G::WIDTH; ++f)
+        {
+            if (2*f - (G::WIDTH - 1) == -distance || 2*f - (G::WIDTH - 1) == distance) files[i++] = G::file(f);
+        }
+    }
+    return files;
+}
+
+// Used for checking moves from center outward, on a board of any size.
+template <class G>
+inline constexpr std::array<typename G::Board, G::WIDTH> move_order_of = center_out_files<G>();
+
+// Files D, C, E, F, B, A, G on the standard board
+template <>
+inline constexpr std::array<Bitboard, 7> move_order_of<StandardGeometry> = {FileD_BB, FileC_BB, FileE_BB, FileF_BB, FileB_BB, FileA_BB, FileG_BB};
+
+inline constexpr const std::array<Bitboard, 7> & move_order = move_order_of<StandardGeometry>;
+
+
 /// @brief A struct to store a move and its associated number of winning positions.
-struct ScoredMove
+/// @tparam G The board's geometry.
+template <class G>
+struct BasicScoredMove
 {
     // the tentative move only
-    Bitboard move;
+    typename G::Board move;
 
     // number of winning positions
     int score;
+
+    // our winning positions after the move (empty tiles only), so the child node needn't recompute them
+    typename G::Board threats;
 };
 
+/// @brief Moves sorted by sort_moves: an array of one BasicScoredMove per file and the number n of valid moves in it.
+template <class G>
+using BasicSortedMoves = std::pair<std::array<BasicScoredMove<G>, G::WIDTH>, int>;
+
+// moves on the standard board
+using ScoredMove = BasicScoredMove<StandardGeometry>;
+using SortedMoves = BasicSortedMoves<StandardGeometry>;
+
 
 
 /// @brief Check whether a given bitboard contains a winning piece configuration.
@@ -21,27 +68,29 @@ struct ScoredMove
 /// @return Whether a win was found.
 constexpr bool check_win(Bitboard player_pieces)
 {
-    /* HORIZONTAL */
-    // set mask to player pieces having another piece to their left (decrease index by 7)
-    Bitboard mask = player_pieces & (player_pieces >> 7);
-    // check if 2 consecutive runs of 2 pieces can be found
-    if (mask & (mask >> 14)) return true; // found a sequence
-
-
-    /* DIAGONAL '\' */
-    if (mask & (mask >> 12)) return true; // found a sequence
-
+    return check_win<StandardGeometry>(player_pieces);
+}
 
-    /* DIAGONAL '/' */
-    mask = player_pieces & (player_pieces >> 8); // shift to bottom left
-    if (mask & (mask >> 16)) return true; // found a sequence
 
+/// @brief Check whether a position on a board of any size is its own mirror image.
+/// @tparam G The board's geometry.
+/// @param our_bb Our pieces.
+/// @param their_bb Our opponent's pieces.
+/// @return Whether mirroring the board left to right leaves it unchanged.
+template <class G>
+constexpr bool is_symmetric(typename G::Board our_bb, typename G::Board their_bb)
+{
+    if constexpr (std::is_same_v<G, StandardGeometry>) return mirror_bb(our_bb) == our_bb && mirror_bb(their_bb) == their_bb;
+    else return mirror<G>(our_bb) == our_bb && mirror<G>(their_bb) == their_bb;
+}
 
-    /* VERTICAL */
-    mask = player_pieces & (player_pieces >> 1); // shift down
-    if (mask & (mask >> 2)) return true; // found a sequence
-    
-    return false; // found nothing
+/// @brief Check whether a position is its own mirror image.
+/// @param our_bb Our pieces.
+/// @param their_bb Our opponent's pieces.
+/// @return Whether mirroring the board left to right leaves it unchanged.
+constexpr bool is_symmetric(Bitboard our_bb, Bitboard their_bb)
+{
+    return is_symmetric<StandardGeometry>(our_bb, their_bb);
 }
 
 
@@ -51,11 +100,7 @@ constexpr bool check_win(Bitboard player_pieces)
 /// @return A bitboard of all our legal moves.
 constexpr Bitboard possible_moves(Bitboard our_bb, Bitboard their_bb)
 {
-    // All ranks are stacks of 1's. As such, adding the bottom tile of each
-    // file forces a carry ripple and sets the first non-empty cell of the file to a 1, while
-    // clearing the other ones. Any ripples into the sentinel are cleared by a bitwise AND
-    // with the valid tiles.
-    return ((our_bb|their_bb) + Rank1_BB) & All_Tiles_BB;
+    return possible_moves<StandardGeometry>(our_bb, their_bb);
 }
 
 /// @brief Generate all tiles where we would win if we placed a stone.
@@ -63,76 +108,29 @@ constexpr Bitboard possible_moves(Bitboard our_bb, Bitboard their_bb)
 /// @param their_bb Our opponent's pieces.
 /// @return A bitboard of our winning positions.
 constexpr Bitboard winning_positions(Bitboard our_bb, Bitboard their_bb)
-{   
-    /* VERTICAL */
-    // do some shifts up
-    Bitboard result = (our_bb << 1) & (our_bb << 2) & (our_bb << 3);
-
-
-    /* HORIZONTAL */
-    Bitboard partial = (our_bb << 7) & (our_bb << (2*7)); // shift right 1x + 2x
-
-    // check for missing stone at very right of sequence (shift right 3x)
-    result |= (partial & (our_bb << (7*3)));
-
-    // check for missing stone at second tile from right of sequence (shift left 1x)
-    result |= (partial & (our_bb >> 7));
-
-    // shift partial 3x left
-    partial >>= (3*7);
-
-    // check for missing stone at second tile from left of sequence (shift right 1x)
-    result |= (partial & (our_bb << 7));
-
-    // check for missing stone at very left of sequence (shift left 3x)
-    result |= (partial & (our_bb >> (7*3)));
-
-
-
-    /* DIAGONAL '\' */
-    partial = (our_bb << 6) & (our_bb << (2*6)); // shift down-right 1x + 2x
-
-    // check for missing stone at very right of sequence (shift down-right 3x)
-    result |= (partial & (our_bb << (6*3)));
-
-    // check for missing stone at second tile from right of sequence (shift up-left 1x)
-    result |= (partial & (our_bb >> 6));
-
-    // shift partial 3x up-left
-    partial >>= (3*6);
-
-    // check for missing stone at second tile from left of sequence
-    // (shift down-right 1x)
-    result |= (partial & (our_bb << 6));
-
-    // check for missing stone at very left of sequence (shift up-left 3x)
-    result |= (partial & (our_bb >> (6*3)));
-    
-
-    
-    /* DIAGONAL '/' */
-    partial = (our_bb << 8) & (our_bb << (2*8)); // shift up-right 1x + 2x
-
-    // check for missing stone at very right of sequence (shift up-right 3x)
-    result |= (partial & (our_bb << (8*3)));
-
-    // check for missing stone at second tile from right of sequence (shift down-left 1x)
-    result |= (partial & (our_bb >> 8));
-
-    // shift partial 3x down-left
-    partial >>= (3*8);
-
-    // check for missing stone at second tile from left of sequence
-    // (shift up-right 1x)
-    result |= (partial & (our_bb << 8));
-
-    // check for missing stone at very left of sequence (shift down-left 3x)
-    result |= (partial & (our_bb >> (8*3)));
+{
+    return winning_positions<StandardGeometry>(our_bb, their_bb);
+}
 
-    // MORE STUFF HERE
+/// @brief Keep the legal moves which do not make us lose when our opponent replies.
+/// @param possible Our legal moves.
+/// @param opponent_win Our opponent's winning positions, as returned by winning_positions.
+/// @return A bitboard of all our non-losing moves.
+constexpr Bitboard non_losing_moves(Bitboard possible, Bitboard opponent_win)
+{
+    return non_losing_moves<StandardGeometry>(possible, opponent_win);
+}
 
-    // constrain result to empty tiles
-    return (result & (All_Tiles_BB ^ (our_bb|their_bb)));
+/// @brief Generate all legal moves on a board of any size which do not make us lose when our opponent replies.
+/// @tparam G The board's geometry.
+/// @param our_bb Our pieces.
+/// @param their_bb Our opponent's pieces.
+/// @return A bitboard of all our non-losing moves.
+template <class G>
+constexpr typename G::Board possible_non_losing_moves(typename G::Board our_bb, typename G::Board their_bb)
+{
+    // notice the argument inversion here (check if OPPONENT can win)
+    return non_losing_moves<G>(possible_moves<G>(our_bb, their_bb), winning_positions<G>(their_bb, our_bb));
 }
 
 /// @brief Generate all legal moves which do not make us lose when our opponent replies.
@@ -141,64 +139,82 @@ constexpr Bitboard winning_positions(Bitboard our_bb, Bitboard their_bb)
 /// @return A bitboard of all our non-losing moves.
 constexpr Bitboard possible_non_losing_moves(Bitboard our_bb, Bitboard their_bb)
 {
-    Bitboard possible = possible_moves(our_bb, their_bb);
-
-    // notice the argument inversion here (check if OPPONENT can win)
-    Bitboard opponent_win = winning_positions(their_bb, our_bb);
-
-    // we must play these to not lose
-    Bitboard forced = possible & opponent_win;
-
-    if (forced)
-    {
-        if (forced & (forced-1)) // more than one opponent win possible
-        {
-            return 0;
-        }
-        else // only one forced move
-        {
-            possible = forced;
-        }
-    }
-
-    // don't play under a winning position
-    return possible & ~(opponent_win >> 1);
+    return possible_non_losing_moves<StandardGeometry>(our_bb, their_bb);
 }
 
 
 
-/// @brief Sort all possible moves for a given position by the number of winning positions (empty slots) they create.
+/// @brief Sort all possible moves for a position on a board of any size by the number of winning positions
+/// (empty slots) they create, most first. Moves creating as many are ordered as in move_order_of.
+/// @tparam G The board's geometry.
 /// @param our_bb Our pieces.
 /// @param their_bb Our opponent's pieces.
-/// @return A pair of the number of possible moves (n) and of an array of 7 ScoredMove, of which indices [0, n[ are valid moves. Index n-1 is best.
-inline auto sort_moves(Bitboard our_bb, Bitboard their_bb)
+/// @param possible Our non-losing moves, as returned by possible_non_losing_moves.
+/// @return A pair of the number of possible moves (n) and of an array of one BasicScoredMove per file,
+/// of which indices [0, n[ are valid moves. Index 0 is best.
+template <class G>
+inline BasicSortedMoves<G> sort_moves(typename G::Board our_bb, typename G::Board their_bb, typename G::Board possible)
 {
-    Bitboard possible = possible_non_losing_moves(our_bb, their_bb);
+    using Board = typename G::Board;
 
     // not pre-initialized, so it's not a constexpr function
-    std::array<ScoredMove, 7> move_arr;
+    std::array<BasicScoredMove<G>, G::WIDTH> move_arr;
 
-    // used to count iterations
+    // used to count moves
     int i = 0;
-    for ( ; possible != Empty_BB; ++i)
+    for (int col_index = 0; col_index < G::WIDTH; ++col_index)
     {
-        // isolate LS set bit
-        Bitboard tentative_move_only = possible & -possible;
-        
-        // clear bit from possible moves
-        possible ^= tentative_move_only;
-        
-        Bitboard tentative_move = (tentative_move_only | our_bb);
+        // isolate tentative move from legal moves in order
+        Board tentative_move_only = possible & move_order_of<G>[col_index];
+
+        // if tentative move is nonexistent, continue
+        if (tentative_move_only == 0) continue;
+
+        Board tentative_move = (tentative_move_only | our_bb);
 
         // set current entry to tentative move and score after move
-        move_arr[i] = ScoredMove{tentative_move, popcount(winning_positions(tentative_move, their_bb))};
+        Board threats = winning_positions<G>(tentative_move, their_bb);
+        move_arr[i] = BasicScoredMove<G>{tentative_move, popcount<G>(threats), threats};
 
-        // sort current move into array (insertion sort)
-        for (int j = i; j > 0 && (move_arr[j-1].score > move_arr[j].score); --j)
+        // sort current move into array (stable insertion sort, so ties keep the center-first order)
+        for (int j = i; j > 0 && (move_arr[j-1].score < move_arr[j].score); --j)
         {
             std::swap(move_arr[j-1], move_arr[j]);
         }
+
+        ++i;
     }
 
-    return std::make_pair(move_arr, i);
-}
\ No newline at end of file
+    return BasicSortedMoves<G>(move_arr, i);
+}
+
+/// @brief Sort all possible moves for a position on a board of any size by the number of winning positions they create.
+/// @tparam G The board's geometry.
+/// @param our_bb Our pieces.
+/// @param their_bb Our opponent's pieces.
+/// @return The same as sort_moves with our non-losing moves.
+template <class G>
+inline BasicSortedMoves<G> sort_moves(typename G::Board our_bb, typename G::Board their_bb)
+{
+    return sort_moves<G>(our_bb, their_bb, possible_non_losing_moves<G>(our_bb, their_bb));
+}
+
+/// @brief Sort all possible moves for a given position by the number of winning positions (empty slots) they create,
+/// most first. Moves creating as many are ordered from the center outward, as in move_order.
+/// @param our_bb Our pieces.
+/// @param their_bb Our opponent's pieces.
+/// @param possible Our non-losing moves, as returned by possible_non_losing_moves.
+/// @return A pair of the number of possible moves (n) and of an array of 7 ScoredMove, of which indices [0, n[ are valid moves. Index 0 is best.
+inline SortedMoves sort_moves(Bitboard our_bb, Bitboard their_bb, Bitboard possible)
+{
+    return sort_moves<StandardGeometry>(our_bb, their_bb, possible);
+}
+
+/// @brief Sort all possible moves for a given position by the number of winning positions (empty slots) they create.
+/// @param our_bb Our pieces.
+/// @param their_bb Our opponent's pieces.
+/// @return A pair of the number of possible moves (n) and of an array of 7 ScoredMove, of which indices [0, n[ are valid moves. Index 0 is best.
+inline SortedMoves sort_moves(Bitboard our_bb, Bitboard their_bb)
+{
+    return sort_moves(our_bb, their_bb, possible_non_losing_moves(our_bb, their_bb));
+}
@@ -0,0 +1,286 @@
+#include "sort_moves_simd.h"
+
+#include <cstring>
+
+// The vector code is built with per-function target attributes, so the rest of the program
+// doesn't need to be compiled for a CPU that has it: it is only called once the CPU was checked.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define C4_X86_SIMD
+#include <immintrin.h>
+#define C4_TARGET_AVX2 __attribute__((target("avx2")))
+#define C4_TARGET_AVX512 __attribute__((target("avx2,avx512f,avx512vpopcntdq")))
+#endif
+
+
+bool move_sorter_supported(MoveSorter sorter)
+{
+    switch (sorter)
+    {
+        case MoveSorter::Scalar: return true;
+#ifdef C4_X86_SIMD
+        case MoveSorter::AVX2: return __builtin_cpu_supports("avx2");
+        case MoveSorter::AVX512: return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("avx512f")
+                                        && __builtin_cpu_supports("avx512vpopcntdq");
+#endif
+        default: return false;
+    }
+}
+
+MoveSorter best_move_sorter()
+{
+    // AVX2 needs two registers and a lookup table popcount per pass, which measured no faster than the scalar code
+    if (move_sorter_supported(MoveSorter::AVX512)) return MoveSorter::AVX512;
+    return MoveSorter::Scalar;
+}
+
+const char * move_sorter_name(MoveSorter sorter)
+{
+    switch (sorter)
+    {
+        case MoveSorter::AVX2: return "avx2";
+        case MoveSorter::AVX512: return "avx512";
+        default: return "scalar";
+    }
+}
+
+bool parse_move_sorter(const char * name, MoveSorter & sorter)
+{
+    for (MoveSorter s : {MoveSorter::Scalar, MoveSorter::AVX2, MoveSorter::AVX512})
+    {
+        if (std::strcmp(name, move_sorter_name(s)) == 0)
+        {
+            sorter = s;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+#ifdef C4_X86_SIMD
+
+// Lane i holds the child reached by playing on file i (A to G), lane 7 is always empty.
+alignas(64) static const Bitboard lane_files[8] = {FileA_BB, FileB_BB, FileC_BB, FileD_BB,
+                                                    FileE_BB, FileF_BB, FileG_BB, Empty_BB};
+
+// Lane i's rank in move_order, which breaks ties between scores as in sort_moves.
+alignas(64) static const uint64_t lane_ranks[8] = {5, 4, 1, 0, 2, 3, 6, 7};
+
+// Lane of each rank in move_order (the inverse of lane_ranks).
+static const int rank_lanes[8] = {3, 2, 4, 5, 1, 0, 6, 7};
+
+// Files by rank in move_order, then no move for the missing children.
+static const Bitboard ranked_files[8] = {move_order[0], move_order[1], move_order[2], move_order[3],
+                                         move_order[4], move_order[5], move_order[6], Empty_BB};
+
+// Children are sorted by increasing key, (SCORE_LIMIT - score) << 3 | rank: by decreasing score, then from the center outward.
+// Missing children get the largest key, so they end up after the n valid ones.
+constexpr uint32_t SCORE_SHIFT = 3;
+constexpr uint32_t SCORE_LIMIT = 63; // more than the number of squares
+
+
+/// @brief One line direction of winning_positions, for 4 boards.
+/// @tparam D The direction's shift, one of StandardGeometry's.
+/// @param our Our pieces.
+/// @return The tiles completing a line of ours in that direction, empty or not.
+template <int D>
+C4_TARGET_AVX2 static inline __m256i line_threats_avx2(__m256i our)
+{
+    if constexpr (D == StandardGeometry::VERTICAL)
+    {
+        // only stones below can complete a vertical line
+        return _mm256_and_si256(_mm256_and_si256(_mm256_slli_epi64(our, 1), _mm256_slli_epi64(our, 2)),
+                                _mm256_slli_epi64(our, 3));
+    }
+    else
+    {
+        // same steps as winning_positions: a pair of stones, then the two possible missing stones on each side
+        __m256i partial = _mm256_and_si256(_mm256_slli_epi64(our, D), _mm256_slli_epi64(our, 2*D));
+        __m256i result = _mm256_and_si256(partial, _mm256_slli_epi64(our, 3*D));
+        result = _mm256_or_si256(result, _mm256_and_si256(partial, _mm256_srli_epi64(our, D)));
+
+        partial = _mm256_srli_epi64(partial, 3*D);
+        result = _mm256_or_si256(result, _mm256_and_si256(partial, _mm256_slli_epi64(our, D)));
+        return _mm256_or_si256(result, _mm256_and_si256(partial, _mm256_srli_epi64(our, 3*D)));
+    }
+}
+
+/// @brief winning_positions, for 4 boards.
+/// @param our Our pieces.
+/// @param empty The empty tiles.
+/// @return Our winning positions, in each 64-bit lane.
+C4_TARGET_AVX2 static inline __m256i winning_positions_avx2(__m256i our, __m256i empty)
+{
+    using G = StandardGeometry;
+    __m256i threats = _mm256_or_si256(_mm256_or_si256(line_threats_avx2<G::VERTICAL>(our), line_threats_avx2<G::HORIZONTAL>(our)),
+                                      _mm256_or_si256(line_threats_avx2<G::DIAGONAL_DOWN>(our), line_threats_avx2<G::DIAGONAL_UP>(our)));
+    return _mm256_and_si256(threats, empty);
+}
+
+/// @brief popcount, for 4 boards.
+/// @param threats The bitboards.
+/// @return The number of set bits, in each 64-bit lane.
+C4_TARGET_AVX2 static inline __m256i popcount_avx2(__m256i threats)
+{
+
+    // no 64-bit popcount before AVX-512: count each nibble with a lookup table, then add up each lane's bytes
+    const __m256i nibble_counts = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                                   0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low_nibbles = _mm256_set1_epi8(0x0F);
+
+    __m256i low = _mm256_shuffle_epi8(nibble_counts, _mm256_and_si256(threats, low_nibbles));
+    __m256i high = _mm256_shuffle_epi8(nibble_counts, _mm256_and_si256(_mm256_srli_epi16(threats, 4), low_nibbles));
+
+    return _mm256_sad_epu8(_mm256_add_epi8(low, high), _mm256_setzero_si256());
+}
+
+/// @brief One layer of the sorting network: compare each lane with its partner, the lower lane keeping the minimum.
+/// @tparam Max_Lanes The lanes keeping the maximum, one bit per lane.
+/// @param keys The keys.
+/// @param partners Each lane's partner, itself if it isn't compared.
+/// @return The keys after the layer.
+template <int Max_Lanes>
+C4_TARGET_AVX2 static inline __m256i compare_exchange(__m256i keys, __m256i partners)
+{
+    __m256i other = _mm256_permutevar8x32_epi32(keys, partners);
+    return _mm256_blend_epi32(_mm256_min_epu32(keys, other), _mm256_max_epu32(keys, other), Max_Lanes);
+}
+
+/// @brief Sort 8 keys in increasing order with a 19 comparator, 6 layer sorting network.
+C4_TARGET_AVX2 static inline __m256i sort_keys(__m256i keys)
+{
+    keys = compare_exchange<0xCC>(keys, _mm256_setr_epi32(2, 3, 0, 1, 6, 7, 4, 5));
+    keys = compare_exchange<0xF0>(keys, _mm256_setr_epi32(4, 5, 6, 7, 0, 1, 2, 3));
+    keys = compare_exchange<0xAA>(keys, _mm256_setr_epi32(1, 0, 3, 2, 5, 4, 7, 6));
+    keys = compare_exchange<0x30>(keys, _mm256_setr_epi32(0, 1, 4, 5, 2, 3, 6, 7));
+    keys = compare_exchange<0x50>(keys, _mm256_setr_epi32(0, 4, 2, 6, 1, 5, 3, 7));
+    keys = compare_exchange<0x54>(keys, _mm256_setr_epi32(0, 2, 1, 4, 3, 6, 5, 7));
+    return keys;
+}
+
+/// @brief Turn sorted keys back into moves.
+/// @param keys The sorted keys.
+/// @param our_bb Our pieces.
+/// @param possible Our non-losing moves.
+/// @param lane_threats Our winning positions after each lane's move.
+/// @return The moves, as sort_moves returns them.
+static inline SortedMoves unpack_keys(const uint32_t (&keys)[8], Bitboard our_bb, Bitboard possible,
+                                      const Bitboard (&lane_threats)[8])
+{
+    std::array<ScoredMove, 7> move_arr;
+
+    // filling the invalid entries too avoids a branch per move
+    for (int i = 0; i < 7; ++i)
+    {
+        move_arr[i] = ScoredMove{our_bb | (possible & ranked_files[keys[i] & 7]),
+                                 static_cast<int>(SCORE_LIMIT - (keys[i] >> SCORE_SHIFT)),
+                                 lane_threats[rank_lanes[keys[i] & 7]]};
+    }
+
+    return SortedMoves(move_arr, popcount(possible));
+}
+
+
+C4_TARGET_AVX2 SortedMoves sort_moves_avx2(Bitboard our_bb, Bitboard their_bb, Bitboard possible)
+{
+    const __m256i our = _mm256_set1_epi64x(our_bb);
+    const __m256i occupied = _mm256_set1_epi64x(our_bb | their_bb);
+    const __m256i all_tiles = _mm256_set1_epi64x(All_Tiles_BB);
+    const __m256i missing = _mm256_set1_epi64x(-1);
+
+    __m256i halves[2];
+    alignas(32) Bitboard lane_threats[8];
+
+    // files A-D, then files E-G and the empty lane
+    for (int h = 0; h < 2; ++h)
+    {
+        __m256i files = _mm256_load_si256(reinterpret_cast<const __m256i *>(lane_files + 4*h));
+        __m256i moves = _mm256_and_si256(_mm256_set1_epi64x(possible), files);
+
+        __m256i child = _mm256_or_si256(our, moves);
+        __m256i empty = _mm256_andnot_si256(_mm256_or_si256(occupied, moves), all_tiles);
+
+        __m256i ranks = _mm256_load_si256(reinterpret_cast<const __m256i *>(lane_ranks + 4*h));
+        __m256i threats = winning_positions_avx2(child, empty);
+        _mm256_store_si256(reinterpret_cast<__m256i *>(lane_threats + 4*h), threats);
+
+        __m256i scores = _mm256_sub_epi64(_mm256_set1_epi64x(SCORE_LIMIT), popcount_avx2(threats));
+        __m256i keys = _mm256_or_si256(_mm256_slli_epi64(scores, SCORE_SHIFT), ranks);
+
+        halves[h] = _mm256_or_si256(keys, _mm256_and_si256(_mm256_cmpeq_epi64(moves, _mm256_setzero_si256()), missing));
+    }
+
+    // keys fit in 32 bits: gather the low halves of the 8 lanes into one register
+    __m256i low = _mm256_permutevar8x32_epi32(halves[0], _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6));
+    __m256i high = _mm256_permutevar8x32_epi32(halves[1], _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6));
+
+    alignas(32) uint32_t keys[8];
+    _mm256_store_si256(reinterpret_cast<__m256i *>(keys), sort_keys(_mm256_blend_epi32(low, high, 0xF0)));
+
+    return unpack_keys(keys, our_bb, possible, lane_threats);
+}
+
+
+/// @brief One line direction of winning_positions, for 8 boards.
+/// @tparam D The direction's shift, one of StandardGeometry's.
+/// @param our Our pieces.
+/// @return The tiles completing a line of ours in that direction, empty or not.
+template <int D>
+C4_TARGET_AVX512 static inline __m512i line_threats_avx512(__m512i our)
+{
+    if constexpr (D == StandardGeometry::VERTICAL)
+    {
+        // only stones below can complete a vertical line
+        return _mm512_and_si512(_mm512_and_si512(_mm512_slli_epi64(our, 1), _mm512_slli_epi64(our, 2)),
+                                _mm512_slli_epi64(our, 3));
+    }
+    else
+    {
+        // same steps as winning_positions: a pair of stones, then the two possible missing stones on each side
+        __m512i partial = _mm512_and_si512(_mm512_slli_epi64(our, D), _mm512_slli_epi64(our, 2*D));
+        __m512i result = _mm512_and_si512(partial, _mm512_slli_epi64(our, 3*D));
+        result = _mm512_or_si512(result, _mm512_and_si512(partial, _mm512_srli_epi64(our, D)));
+
+        partial = _mm512_srli_epi64(partial, 3*D);
+        result = _mm512_or_si512(result, _mm512_and_si512(partial, _mm512_slli_epi64(our, D)));
+        return _mm512_or_si512(result, _mm512_and_si512(partial, _mm512_srli_epi64(our, 3*D)));
+    }
+}
+
+C4_TARGET_AVX512 SortedMoves sort_moves_avx512(Bitboard our_bb, Bitboard their_bb, Bitboard possible)
+{
+    __m512i files = _mm512_load_si512(lane_files);
+    __m512i moves = _mm512_and_si512(_mm512_set1_epi64(possible), files);
+
+    __m512i child = _mm512_or_si512(_mm512_set1_epi64(our_bb), moves);
+    __m512i empty = _mm512_andnot_si512(_mm512_or_si512(_mm512_set1_epi64(our_bb | their_bb), moves),
+                                        _mm512_set1_epi64(All_Tiles_BB));
+
+    using G = StandardGeometry;
+    __m512i threats = _mm512_or_si512(_mm512_or_si512(line_threats_avx512<G::VERTICAL>(child), line_threats_avx512<G::HORIZONTAL>(child)),
+                                      _mm512_or_si512(line_threats_avx512<G::DIAGONAL_DOWN>(child), line_threats_avx512<G::DIAGONAL_UP>(child)));
+
+    threats = _mm512_and_si512(threats, empty);
+
+    alignas(64) Bitboard lane_threats[8];
+    _mm512_store_si512(lane_threats, threats);
+
+    __m512i scores = _mm512_sub_epi64(_mm512_set1_epi64(SCORE_LIMIT), _mm512_popcnt_epi64(threats));
+    __m512i keys = _mm512_or_si512(_mm512_slli_epi64(scores, SCORE_SHIFT), _mm512_load_si512(lane_ranks));
+    keys = _mm512_mask_blend_epi64(_mm512_test_epi64_mask(moves, moves), _mm512_set1_epi64(-1), keys);
+
+    // keys fit in 32 bits, and 8 of them in an AVX2 register
+    alignas(32) uint32_t sorted_keys[8];
+    _mm256_store_si256(reinterpret_cast<__m256i *>(sorted_keys), sort_keys(_mm512_cvtepi64_epi32(keys)));
+
+    return unpack_keys(sorted_keys, our_bb, possible, lane_threats);
+}
+
+#else
+
+// no vector code for this CPU or compiler: move_sorter_supported never lets these be called
+SortedMoves sort_moves_avx2(Bitboard our_bb, Bitboard their_bb, Bitboard possible) { return sort_moves(our_bb, their_bb, possible); }
+SortedMoves sort_moves_avx512(Bitboard our_bb, Bitboard their_bb, Bitboard possible) { return sort_moves(our_bb, their_bb, possible); }
+
+#endif
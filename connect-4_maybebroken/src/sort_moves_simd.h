@@ -0,0 +1,72 @@
+#pragma once
+
+#include "constants.h"
+#include "search_helpers.h"
+
+
+// Vectorized versions of sort_moves, which score all 7 children in one pass and sort them with a sorting network.
+// They return exactly what sort_moves returns, so searches visit the same nodes whichever one is used.
+
+
+/// @brief The implementations of sort_moves, from the portable one to the widest vector one.
+enum class MoveSorter : int
+{
+    Scalar, // sort_moves itself
+    AVX2, // 2x4 lanes, popcount by nibble lookup
+    AVX512 // 8 lanes, needs AVX-512F and VPOPCNTDQ
+};
+
+/// @brief Check whether the CPU running the program (and the compiler building it) supports an implementation.
+/// @param sorter The implementation.
+/// @return Whether sort_moves_with may be called with it.
+bool move_sorter_supported(MoveSorter sorter);
+
+/// @brief Pick the fastest implementation the CPU supports: AVX512 if possible, Scalar otherwise.
+/// @return The implementation.
+MoveSorter best_move_sorter();
+
+/// @brief Get an implementation's name, as accepted by parse_move_sorter.
+/// @param sorter The implementation.
+/// @return "scalar", "avx2" or "avx512".
+const char * move_sorter_name(MoveSorter sorter);
+
+/// @brief Parse an implementation's name.
+/// @param name The name, as returned by move_sorter_name.
+/// @param sorter Receives the implementation.
+/// @return Whether the name was valid.
+bool parse_move_sorter(const char * name, MoveSorter & sorter);
+
+/// @brief sort_moves, 4 lanes at a time. The CPU must support AVX2.
+SortedMoves sort_moves_avx2(Bitboard our_bb, Bitboard their_bb, Bitboard possible);
+
+/// @brief sort_moves, 8 lanes at a time. The CPU must support AVX-512F and VPOPCNTDQ.
+SortedMoves sort_moves_avx512(Bitboard our_bb, Bitboard their_bb, Bitboard possible);
+
+/// @brief Call an implementation of sort_moves.
+/// @param sorter The implementation, which must be supported.
+/// @param our_bb Our pieces.
+/// @param their_bb Our opponent's pieces.
+/// @param possible Our non-losing moves, as returned by possible_non_losing_moves.
+/// @return What sort_moves returns.
+inline SortedMoves sort_moves_with(MoveSorter sorter, Bitboard our_bb, Bitboard their_bb, Bitboard possible)
+{
+    // the scalar code's cost grows with the number of moves, the vector code's doesn't
+    if (popcount(possible) < SIMD_SORT_MIN_MOVES) return sort_moves(our_bb, their_bb, possible);
+
+    switch (sorter)
+    {
+        case MoveSorter::AVX2: return sort_moves_avx2(our_bb, their_bb, possible);
+        case MoveSorter::AVX512: return sort_moves_avx512(our_bb, their_bb, possible);
+        default: return sort_moves(our_bb, their_bb, possible);
+    }
+}
+
+/// @brief Call an implementation of sort_moves.
+/// @param sorter The implementation, which must be supported.
+/// @param our_bb Our pieces.
+/// @param their_bb Our opponent's pieces.
+/// @return What sort_moves returns.
+inline SortedMoves sort_moves_with(MoveSorter sorter, Bitboard our_bb, Bitboard their_bb)
+{
+    return sort_moves_with(sorter, our_bb, their_bb, possible_non_losing_moves(our_bb, their_bb));
+}
@@ -0,0 +1,62 @@
+#include "stats.h"
+
+
+SearchStats & SearchStats::operator+=(const SearchStats & other)
+{
+    nodes += other.nodes;
+    tt_probes += other.tt_probes;
+    tt_hits += other.tt_hits;
+
+    for (int depth = 0; depth <= MAX_BOARD_STONES; ++depth) nodes_per_depth[depth] += other.nodes_per_depth[depth];
+
+    tt_stores += other.tt_stores;
+    tt_overwrites += other.tt_overwrites;
+    early_prunes += other.early_prunes;
+    tt_lower_cutoffs += other.tt_lower_cutoffs;
+    etc_cutoffs += other.etc_cutoffs;
+    threat_cutoffs += other.threat_cutoffs;
+
+    for (int i = 0; i < MAX_BOARD_WIDTH; ++i) cutoffs_by_move[i] += other.cutoffs_by_move[i];
+
+    null_window_iterations += other.null_window_iterations;
+
+    return *this;
+}
+
+void print_search_stats(const SearchStats & stats, std::ostream & out)
+{
+    out << "nodes: " << stats.nodes << '\n';
+    out << "TT probes: " << stats.tt_probes << ", hits: " << stats.tt_hits << '\n';
+
+    if (!SEARCH_STATS_ENABLED)
+    {
+        out << "(build with SEARCH_STATS for detailed statistics)\n";
+        return;
+    }
+
+    out << "TT stores: " << stats.tt_stores << ", overwrites: " << stats.tt_overwrites << '\n';
+    out << "early prunes: " << stats.early_prunes << ", TT lower bound cutoffs: " << stats.tt_lower_cutoffs
+        << ", enhanced transposition cutoffs: " << stats.etc_cutoffs
+        << ", threat cutoffs: " << stats.threat_cutoffs << '\n';
+    out << "null window iterations: " << stats.null_window_iterations << '\n';
+
+    uint64_t cutoffs = 0;
+    for (uint64_t count : stats.cutoffs_by_move) cutoffs += count;
+
+    // how often the first move searched was good enough: the move ordering's quality
+    // the indices only moves of wider boards reach are left out unless used
+    int num_indices = MAX_BOARD_WIDTH;
+    while (num_indices > 7 && !stats.cutoffs_by_move[num_indices - 1]) --num_indices;
+
+    out << "beta cut-offs: " << cutoffs << ", by move index:";
+    for (int i = 0; i < num_indices; ++i) out << ' ' << stats.cutoffs_by_move[i];
+    if (cutoffs) out << " (" << 100.0 * stats.cutoffs_by_move[0] / cutoffs << "% on first move)";
+    out << '\n';
+
+    out << "nodes by depth left:";
+    for (int depth = MAX_BOARD_STONES; depth >= 0; --depth)
+    {
+        if (stats.nodes_per_depth[depth]) out << ' ' << depth << ':' << stats.nodes_per_depth[depth];
+    }
+    out << '\n';
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "constants.h"
+
+#include <cstdint>
+#include <iostream>
+
+
+// Detailed statistics are only collected when built with SEARCH_STATS defined
+// (cmake -DC4_SEARCH_STATS=ON). Otherwise the code collecting them is compiled out.
+#ifdef SEARCH_STATS
+constexpr bool SEARCH_STATS_ENABLED = true;
+#else
+constexpr bool SEARCH_STATS_ENABLED = false;
+#endif
+
+
+/// @brief Work done by a thread's searches, lazy SMP helpers included.
+/// nodes, tt_probes and tt_hits are always collected; the other fields stay 0 unless SEARCH_STATS_ENABLED.
+struct SearchStats
+{
+    uint64_t nodes; // negamax calls
+    uint64_t tt_probes; // transposition table lookups
+    uint64_t tt_hits; // lookups which found an entry
+
+    uint64_t nodes_per_depth[MAX_BOARD_STONES + 1]; // negamax calls, by number of empty squares
+    uint64_t tt_stores; // transposition table saves
+    uint64_t tt_overwrites; // saves which evicted another position's entry
+    uint64_t early_prunes; // nodes cut by the TT or depth upper bound before searching any move
+    uint64_t tt_lower_cutoffs; // nodes cut by the TT lower bound before searching any move
+    uint64_t etc_cutoffs; // nodes cut by a child's TT entry before searching any move (enhanced transposition cutoffs)
+    uint64_t threat_cutoffs; // nodes cut by a zugzwang rule on them or a child before searching any move (threat analysis)
+    uint64_t cutoffs_by_move[MAX_BOARD_WIDTH]; // beta cut-offs, by index of the move causing it in search order
+    uint64_t null_window_iterations; // negamax calls made by root_search
+
+    /// @brief Add another thread's or search's statistics to these.
+    SearchStats & operator+=(const SearchStats & other);
+};
+
+/// @brief Print statistics in a human-readable form.
+/// @param stats The statistics.
+/// @param out The stream to print to.
+void print_search_stats(const SearchStats & stats, std::ostream & out);
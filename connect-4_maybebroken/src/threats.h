@@ -0,0 +1,75 @@
+#pragma once
+
+#include "bitboard.h"
+#include "search_helpers.h"
+
+
+/*
+   Static threat analysis, after Allis ("A Knowledge-based Approach of Connect-Four", 1988).
+
+   Ranks are numbered from 1 at the bottom; an odd threat is an empty square on an odd rank where a player
+   would complete a line. If every file has an even number of empty squares when we are to move, our opponent
+   can answer each of our moves by playing on top of it (follow-up, or "claimeven"): we then get exactly the
+   empty squares on odd ranks, and them those on even ranks, whatever we do. So the game is decided by which
+   lines fit in each player's squares, with no search: this is the zugzwang behind "the first player needs an
+   odd threat, the second player an even one".
+
+   If a single file has an odd number of empty squares, our opponent can still follow up in it up to an odd
+   threat of theirs there, which they then play: we get the odd ranks of the other files and the even ranks
+   below their threat.
+
+   This is for boards of even height. What matters is the parity of a square's distance to the top of its file,
+   so on boards of odd height the odd and even ranks swap roles.
+*/
+
+
+// upper bounds of our score proven by threat_upper_bound
+constexpr int THREAT_DRAW_BOUND = 0; // we can't win
+constexpr int THREAT_LOSS_BOUND = -1; // we lose
+constexpr int THREAT_NO_BOUND = INT8_MAX; // no rule applies, above any score on any board
+
+
+/// @brief Prove an upper bound of a position's score from the follow-up strategies of our opponent, without search.
+/// The bounds are sound whatever the position, as long as the game isn't over.
+/// @tparam G The board's geometry.
+/// @param our_bb Our pieces.
+/// @param their_bb Our opponent's pieces.
+/// @param their_threats Our opponent's winning positions, as returned by winning_positions(their_bb, our_bb).
+/// @return THREAT_LOSS_BOUND if they win by following up, THREAT_DRAW_BOUND if we can't win against it,
+/// THREAT_NO_BOUND if neither could be proven.
+template <class G>
+constexpr int threat_upper_bound(typename G::Board our_bb, typename G::Board their_bb, typename G::Board their_threats)
+{
+    using Board = typename G::Board;
+
+    // the ranks playing the role of the odd and even ones of a board of even height
+    constexpr Board Odd_BB = G::HEIGHT % 2 == 0 ? G::Odd_Ranks_BB : G::Even_Ranks_BB;
+    constexpr Board Even_BB = G::HEIGHT % 2 == 0 ? G::Even_Ranks_BB : G::Odd_Ranks_BB;
+
+    Board empty = G::All_Tiles_BB ^ (our_bb|their_bb);
+
+    // the lowest empty square of each file is on an even rank if (and only if) the file has an odd number of them
+    Board odd_files = possible_moves<G>(our_bb, their_bb) & Even_BB;
+
+    if (odd_files == 0)
+    {
+        // claimeven: we get the odd ranks, they get the even ranks
+        if (check_win<G>(our_bb | (empty & Odd_BB))) return THREAT_NO_BOUND;
+
+        return check_win<G>(their_bb | (empty & Even_BB)) ? THREAT_LOSS_BOUND : THREAT_DRAW_BOUND;
+    }
+
+    // more than one file they can't follow up in
+    if (odd_files & (odd_files - 1)) return THREAT_NO_BOUND;
+
+    // their lowest odd threat in that file, which they will get (the empty squares there start on an even rank)
+    Board file = G::file(lsb_index<G>(odd_files) / G::FILE_BITS);
+    Board threat = their_threats & file & Odd_BB;
+    if (threat == 0) return THREAT_NO_BOUND;
+    threat &= -threat;
+
+    // we get the odd ranks of the other files, and the even ranks below their threat: the game ends there
+    Board our_squares = our_bb | (empty & Odd_BB & ~file) | (empty & file & Even_BB & (threat - 1));
+
+    return check_win<G>(our_squares) ? THREAT_NO_BOUND : THREAT_LOSS_BOUND;
+}
@@ -0,0 +1,177 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "the trace file is little-endian");
+static_assert((TRACE_RING_SIZE & (TRACE_RING_SIZE - 1)) == 0, "ring indices are masked");
+
+SearchTrace search_trace;
+
+/// @brief The current thread's ring, retired when the thread exits.
+struct TraceRingHandle
+{
+    SearchTrace::Ring * ring = nullptr;
+    uint64_t epoch = 0; // of the trace the ring was registered with, 0 if none
+
+    ~TraceRingHandle()
+    {
+        // rings of finished traces were freed already
+        if (ring && epoch == search_trace.m_epoch.load(std::memory_order_relaxed))
+        {
+            ring->retired.store(true, std::memory_order_release);
+        }
+    }
+};
+
+static thread_local TraceRingHandle t_ring;
+
+SearchTrace::~SearchTrace()
+{
+    stop();
+}
+
+bool SearchTrace::start(const char * path, int min_depth, int sample_log2)
+{
+    stop();
+
+    if (!m_file.open(path, TRACE_FILE_HEADER_SIZE)) return false;
+
+    m_num_records = 0;
+    m_num_dropped = 0;
+    m_min_depth = min_depth;
+    m_sample_mask = sample_log2 < 0 ? UINT64_MAX : (1ULL << std::min(sample_log2, 63)) - 1;
+
+    // threads register new rings
+    m_epoch.fetch_add(1, std::memory_order_relaxed);
+
+    m_stopping = false;
+    m_writer = std::thread(&SearchTrace::write_loop, this);
+
+    m_active = true;
+    return true;
+}
+
+TraceSummary SearchTrace::stop()
+{
+    if (!m_file.is_open()) return TraceSummary{false, 0, 0};
+
+    m_active = false;
+
+    // the writer drains the rings once more before exiting
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wakeup.notify_one();
+    m_writer.join();
+
+    // the rings of threads still alive are freed with the trace
+    for (const auto & ring : m_rings) m_num_dropped += ring->num_dropped.load(std::memory_order_relaxed);
+    m_rings.clear();
+    m_epoch.fetch_add(1, std::memory_order_relaxed);
+
+    TraceHeader header{TRACE_FILE_MAGIC, TRACE_FILE_VERSION, TRACE_RECORD_SIZE, NUM_STONES, m_num_records, m_num_dropped};
+    bool ok = m_file.close(&header, sizeof(header));
+
+    return TraceSummary{ok, m_num_records, m_num_dropped};
+}
+
+SearchTrace::Ring * SearchTrace::thread_ring()
+{
+    uint64_t epoch = m_epoch.load(std::memory_order_relaxed);
+    if (t_ring.epoch == epoch) return t_ring.ring;
+
+    // first record of this thread in this trace (the buffer's pages are only touched as it fills)
+    auto ring = std::make_unique<Ring>();
+    ring->records.reset(new TraceRecord[TRACE_RING_SIZE]);
+
+    t_ring.ring = ring.get();
+    t_ring.epoch = epoch;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_rings.push_back(std::move(ring));
+
+    return t_ring.ring;
+}
+
+void SearchTrace::record(const TraceRecord & record)
+{
+    Ring * ring = thread_ring();
+
+    // only this thread moves the head
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+
+    if (head - ring->tail.load(std::memory_order_acquire) >= TRACE_RING_SIZE)
+    {
+        ring->num_dropped.store(ring->num_dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return;
+    }
+
+    ring->records[head & (TRACE_RING_SIZE - 1)] = record;
+
+    // publishes the record to the writer
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+void SearchTrace::drain()
+{
+    // only the writer frees rings, so these stay valid without holding the lock while writing
+    std::vector<Ring *> rings;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto & ring : m_rings) rings.push_back(ring.get());
+    }
+
+    // exited threads' rings, drained for the last time below
+    std::vector<Ring *> retired;
+
+    for (Ring * ring : rings)
+    {
+        // read before the head, so that a retired ring's last records are drained below
+        if (ring->retired.load(std::memory_order_acquire)) retired.push_back(ring);
+
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+
+        // the buffered records wrap around at most once
+        while (tail != head)
+        {
+            size_t begin = tail & (TRACE_RING_SIZE - 1);
+            size_t count = std::min<uint64_t>(head - tail, TRACE_RING_SIZE - begin);
+
+            if (m_file.write(&ring->records[begin], count*sizeof(TraceRecord))) m_num_records += count;
+
+            tail += count;
+        }
+
+        // hands the slots back to the search thread
+        ring->tail.store(tail, std::memory_order_release);
+    }
+
+    if (retired.empty()) return;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto drained = [&](const std::unique_ptr<Ring> & ring)
+    {
+        if (std::find(retired.begin(), retired.end(), ring.get()) == retired.end()) return false;
+
+        m_num_dropped += ring->num_dropped.load(std::memory_order_relaxed);
+        return true;
+    };
+    m_rings.erase(std::remove_if(m_rings.begin(), m_rings.end(), drained), m_rings.end());
+}
+
+void SearchTrace::write_loop()
+{
+    for (bool stopping = false; !stopping; )
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wakeup.wait_for(lock, std::chrono::milliseconds(TRACE_FLUSH_INTERVAL_MS), [this]{ return m_stopping; });
+            stopping = m_stopping;
+        }
+
+        drain();
+    }
+}
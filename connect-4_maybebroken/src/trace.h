@@ -0,0 +1,195 @@
+#pragma once
+
+#include "bitboard.h"
+
+#include "constants.h"
+#include "headered_file.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// Search tracing is only compiled in when built with SEARCH_TRACE defined
+// (cmake -DC4_SEARCH_TRACE=ON). Otherwise negamax has no trace code at all.
+#ifdef SEARCH_TRACE
+constexpr bool SEARCH_TRACE_ENABLED = true;
+#else
+constexpr bool SEARCH_TRACE_ENABLED = false;
+#endif
+
+
+/// @brief How a traced node returned.
+enum class TraceExit : uint8_t
+{
+    AllMoves, // every move searched: fail-low, or exact if a move raised alpha (the record's move)
+    Cutoff, // beta cut-off by the record's move
+    NoMoves, // no non-losing moves
+    TTLower, // the TT's lower bound reached beta
+    Pruned, // the TT's or the threat analysis' upper bound reached alpha
+    ETC, // a child's TT entry reached beta (the record's move)
+    Threat, // the record's move leaves our opponent lost to our follow-up
+    Stopped // the search was abandoned, the result is meaningless
+};
+
+// Record layout, node word: key in bits 0-48, depth left in bits 49-54, move file + 1 (0 for none) in bits 55-57,
+// the move's index in search order in bits 58-60, TT hit in bit 61.
+// Result word: alpha, beta and the result (int8) in bits 0-23, the exit in bits 24-31,
+// the nodes searched in the subtree (saturated) in bits 32-63.
+constexpr int TRACE_DEPTH_SHIFT = 49;
+constexpr int TRACE_MOVE_SHIFT = 55;
+constexpr int TRACE_INDEX_SHIFT = 58;
+constexpr int TRACE_TT_HIT_SHIFT = 61;
+constexpr int TRACE_EXIT_SHIFT = 24;
+constexpr int TRACE_NODES_SHIFT = 32;
+constexpr uint64_t TRACE_KEY_MASK = (1ULL << TRACE_DEPTH_SHIFT) - 1;
+static_assert(StandardGeometry::NUM_BITS <= TRACE_DEPTH_SHIFT, "keys must fit below the record's depth");
+
+/// @brief A traced node, written when it returns: 16 little-endian bytes (see tools/trace_summary.py).
+struct TraceRecord
+{
+    uint64_t node_word; // the position and how it was searched
+    uint64_t result_word; // the window, the result and the subtree's size
+
+    /// @brief Build a record.
+    /// @param key The position's key (see make_key).
+    /// @param depth_left The number of empty squares.
+    /// @param alpha The window negamax was called with, clamped to int8.
+    /// @param beta
+    /// @param result The returned score.
+    /// @param exit How the node returned.
+    /// @param move_file The file of the move which cut off or raised alpha, TT_NO_MOVE if none.
+    /// @param move_index The move's index in search order.
+    /// @param tt_hit Whether the node's TT probe found an entry.
+    /// @param nodes The nodes searched in the subtree, the node itself included.
+    static TraceRecord make(uint64_t key, int depth_left, int alpha, int beta, int result, TraceExit exit,
+                            int move_file, int move_index, bool tt_hit, uint64_t nodes)
+    {
+        auto clamp8 = [](int value) -> uint64_t
+        {
+            return static_cast<uint8_t>(value < INT8_MIN ? INT8_MIN : value > INT8_MAX ? INT8_MAX : value);
+        };
+
+        uint64_t node_word = key
+                           | static_cast<uint64_t>(depth_left) << TRACE_DEPTH_SHIFT
+                           | static_cast<uint64_t>(move_file + 1) << TRACE_MOVE_SHIFT
+                           | static_cast<uint64_t>(move_index) << TRACE_INDEX_SHIFT
+                           | static_cast<uint64_t>(tt_hit) << TRACE_TT_HIT_SHIFT;
+
+        uint64_t result_word = clamp8(alpha) | clamp8(beta) << 8 | clamp8(result) << 16
+                             | static_cast<uint64_t>(exit) << TRACE_EXIT_SHIFT
+                             | (nodes > UINT32_MAX ? UINT32_MAX : nodes) << TRACE_NODES_SHIFT;
+
+        return TraceRecord{node_word, result_word};
+    }
+};
+
+static_assert(sizeof(TraceRecord) == TRACE_RECORD_SIZE, "records must be packed");
+
+/// @brief Header of a trace file, padded to TRACE_FILE_HEADER_SIZE bytes.
+struct TraceHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t num_stones; // of the board geometry the keys are laid out for
+    uint64_t num_records;
+    uint64_t num_dropped; // records lost to full buffers
+};
+
+static_assert(sizeof(TraceHeader) <= TRACE_FILE_HEADER_SIZE, "header must fit its padded block");
+
+/// @brief Totals of a finished trace.
+struct TraceSummary
+{
+    bool ok; // whether the whole file was written
+    uint64_t num_records; // written to the file
+    uint64_t num_dropped; // lost because a thread's buffer was full
+};
+
+/// @brief Records sampled negamax nodes into a binary file, for offline analysis (see tools/trace_summary.py).
+/// Each search thread appends its records to its own lock-free ring buffer of TRACE_RING_SIZE records, which a
+/// background writer thread drains to the file every TRACE_FLUSH_INTERVAL_MS. The search never waits for the file:
+/// records which don't fit a full buffer are dropped and counted instead.
+/// Records are written when their node returns, so each thread's records are in post-order. Only
+/// used by negamax when SEARCH_TRACE_ENABLED.
+class SearchTrace
+{
+public:
+    SearchTrace() = default;
+
+    /// @brief NO COPY CONSTRUCTOR ALLOWED
+    SearchTrace(const SearchTrace&) = delete;
+
+    /// @brief Finish the trace, if any.
+    ~SearchTrace();
+
+    /// @brief Start tracing to a file, replacing it. Must not be called while searching.
+    /// @param path The trace file's path, replaced only once the trace is stopped.
+    /// @param min_depth Nodes with at least this many empty squares are always traced.
+    /// @param sample_log2 One in 2^sample_log2 of the other nodes are traced, none if negative.
+    /// @return Whether the file could be created. Tracing is off if not.
+    bool start(const char * path, int min_depth, int sample_log2);
+
+    /// @brief Stop tracing: drain every buffer and finish the file. Must not be called while searching.
+    /// @return The trace's totals, all 0 if no trace was started.
+    TraceSummary stop();
+
+    /// @brief Check whether a node must be traced.
+    /// @param depth_left The number of empty squares.
+    /// @param nodes The number of nodes the thread searched so far, which spreads the sampled nodes evenly.
+    bool sampled(int depth_left, uint64_t nodes) const
+    {
+        return m_active && (depth_left >= m_min_depth || (nodes & m_sample_mask) == m_sample_mask);
+    }
+
+    /// @brief Append a record to the current thread's buffer, or drop it if the buffer is full.
+    void record(const TraceRecord & record);
+
+private:
+    /// @brief A single-producer, single-consumer ring of records: the search thread moves the head,
+    /// the writer the tail. Both only grow, their difference being the number of records buffered.
+    struct Ring
+    {
+        std::unique_ptr<TraceRecord[]> records;
+        alignas(64) std::atomic<uint64_t> head{0};
+        alignas(64) std::atomic<uint64_t> tail{0};
+        std::atomic<uint64_t> num_dropped{0};
+        std::atomic<bool> retired{false}; // set when the thread exits, the writer then frees the ring once drained
+    };
+
+    /// @brief Get the current thread's ring, registering a new one if the thread has none in this trace.
+    Ring * thread_ring();
+
+    /// @brief Write the records buffered by the rings, freeing the drained rings of exited threads.
+    void drain();
+
+    /// @brief The writer thread's loop.
+    void write_loop();
+
+    bool m_active = false;
+    int m_min_depth = 0;
+    uint64_t m_sample_mask = 0; // nodes whose count has all these bits set are sampled, never if all 64 are
+
+    HeaderedFileWriter m_file; // only written to by the writer thread while tracing
+    uint64_t m_num_records = 0;
+    uint64_t m_num_dropped = 0; // by the freed rings
+
+    // tells the threads' rings from those of earlier traces
+    std::atomic<uint64_t> m_epoch{0};
+
+    std::mutex m_mutex; // guards the ring list and the stop flag
+    std::condition_variable m_wakeup;
+    std::vector<std::unique_ptr<Ring>> m_rings;
+    bool m_stopping = false;
+    std::thread m_writer;
+
+    friend struct TraceRingHandle;
+};
+
+// global search trace, used by negamax
+extern SearchTrace search_trace;
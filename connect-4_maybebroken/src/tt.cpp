@@ -1,53 +1,372 @@
 #include "tt.h"
 
+#include "headered_file.h"
+
+#include <algorithm>
+#include <cstdio>
 #include <cstring>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include <sys/mman.h>
 
 TranspositionTable tt;
 
-constexpr TTKey make_key(Bitboard our_bb, Bitboard their_bb)
+/// @brief Check whether a number is prime, by trial division.
+static bool is_prime(size_t n)
+{
+    if (n < 2) return false;
+    for (size_t d = 2; d*d <= n; ++d)
+    {
+        if (n % d == 0) return false;
+    }
+    return true;
+}
+
+/// @brief Map zeroed memory for the table, aligned to huge pages.
+/// @param bytes The size, a multiple of TT_HUGE_PAGE_SIZE.
+/// @param pages Receives the kind of pages backing it.
+/// @return The memory, nullptr if it could not be mapped.
+static void * map_table(size_t bytes, bool explicit_huge_pages, TTPages & pages)
+{
+    if (explicit_huge_pages)
+    {
+        void * memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (memory != MAP_FAILED)
+        {
+            pages = TTPages::Explicit;
+            return memory;
+        }
+    }
+
+    // map a huge page more, to cut an aligned block out of it
+    void * mapped = mmap(nullptr, bytes + TT_HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapped == MAP_FAILED) return nullptr;
+
+    char * start = static_cast<char *>(mapped);
+    char * aligned = reinterpret_cast<char *>((reinterpret_cast<uintptr_t>(start) + TT_HUGE_PAGE_SIZE - 1) & ~(TT_HUGE_PAGE_SIZE - 1));
+    if (aligned != start) munmap(start, aligned - start);
+    munmap(aligned + bytes, start + TT_HUGE_PAGE_SIZE - aligned);
+
+    // fewer TLB misses, if the kernel agrees
+    pages = (madvise(aligned, bytes, MADV_HUGEPAGE) == 0) ? TTPages::Transparent : TTPages::Normal;
+    return aligned;
+}
+
+template <class G>
+BasicTranspositionTable<G>::BasicTranspositionTable()
+{
+    if (!resize(TT_DEFAULT_SIZE_MB)) throw std::bad_alloc();
+}
+
+template <class G>
+BasicTranspositionTable<G>::~BasicTranspositionTable()
+{
+    if (m_buckets) munmap(m_buckets, m_mapped_bytes);
+}
+
+template <class G>
+bool BasicTranspositionTable<G>::allocate(size_t num_buckets, bool explicit_huge_pages)
+{
+    size_t bytes = (num_buckets*sizeof(Bucket) + TT_HUGE_PAGE_SIZE - 1) & ~(TT_HUGE_PAGE_SIZE - 1);
+
+    TTPages pages;
+    void * memory = map_table(bytes, explicit_huge_pages, pages);
+    if (!memory) return false;
+
+    if (m_buckets) munmap(m_buckets, m_mapped_bytes);
+
+    // anonymous mappings start zeroed, so empty
+    m_buckets = static_cast<Bucket *>(memory);
+    m_num_buckets = num_buckets;
+    if constexpr (!WIDE_ENTRIES) m_reciprocal = static_cast<uint64_t>(((static_cast<unsigned __int128>(1) << RECIPROCAL_SHIFT) - 1) / num_buckets + 1);
+    m_mapped_bytes = bytes;
+    m_pages = pages;
+    m_generation = 0;
+    return true;
+}
+
+template <class G>
+bool BasicTranspositionTable<G>::resize(size_t megabytes, bool explicit_huge_pages)
+{
+    size_t target = std::clamp<size_t>((megabytes << 20) / sizeof(Bucket), MIN_BUCKETS, TT_MAX_BUCKETS);
+
+    // the largest prime which fits, unless that's too few buckets to identify keys
+    size_t num_buckets = target;
+    while (num_buckets >= MIN_BUCKETS && !is_prime(num_buckets)) --num_buckets;
+    if (num_buckets < MIN_BUCKETS)
+    {
+        num_buckets = MIN_BUCKETS;
+        while (!is_prime(num_buckets)) ++num_buckets;
+    }
+
+    return allocate(num_buckets, explicit_huge_pages);
+}
+
+// bits telling whether an entry is used in a generation
+constexpr TTEntry TT_LIVE_MASK = TT_USED_BIT | TT_GENERATION_MASK;
+
+/// @brief Build the key shared by a position and its mirror image, like make_canonical_key.
+/// @tparam G The board's geometry.
+/// @param our_bb Our pieces.
+/// @param their_bb Our opponent's pieces.
+/// @param mirrored Receives whether the key is the mirror image's, so that files must be mirrored too.
+/// @return The canonical key.
+template <class G>
+static inline typename G::Board make_canonical_key(typename G::Board our_bb, typename G::Board their_bb, bool & mirrored)
+{
+    typename G::Board key = make_key<G>(our_bb, their_bb);
+    typename G::Board mirrored_key;
+    if constexpr (std::is_same_v<G, StandardGeometry>) mirrored_key = mirror_bb(key);
+    else mirrored_key = mirror<G>(key);
+    mirrored = mirrored_key < key;
+    return mirrored ? mirrored_key : key;
+}
+
+template <class G>
+void BasicTranspositionTable<G>::clear()
+{
+    // the pages stay mapped and warm, only their entries become stale
+    if ((m_generation >> TT_GENERATION_SHIFT) < TT_MAX_GENERATION)
+    {
+        m_generation += 1ULL << TT_GENERATION_SHIFT;
+        return;
+    }
+
+    // generations would wrap around, and old entries come back to life
+    m_generation = 0;
+    wipe();
+}
+
+template <class G>
+void BasicTranspositionTable<G>::wipe()
+{
+    // unused entries are all zeroes, which is what dropped pages come back as
+    if (madvise(m_buckets, m_mapped_bytes, MADV_DONTNEED) == 0) return;
+
+    // else zero them ourselves, a slice per thread
+    size_t num_threads = std::max(1u, std::thread::hardware_concurrency());
+    size_t slice = (m_num_buckets + num_threads - 1) / num_threads;
+
+    std::vector<std::thread> threads;
+    for (size_t begin = 0; begin < m_num_buckets; begin += slice)
+    {
+        size_t count = std::min(slice, m_num_buckets - begin);
+        threads.emplace_back([this, begin, count]() { std::memset(&m_buckets[begin], 0x00, count*sizeof(m_buckets[0])); });
+    }
+
+    for (auto & thread : threads) thread.join();
+}
+
+template <class G>
+bool BasicTranspositionTable<G>::save(Board our_bb, Board their_bb, int upper_bound, int lower_bound, int move_file)
 {
-    // We use the sum of the bitboard of all pieces and our bitboard as a key.
-    // This is a unique, small and fast representation of the position.
-    return ((our_bb | their_bb) + our_bb);
+    bool mirrored;
+    Board full_key = make_canonical_key<G>(our_bb, their_bb, mirrored);
+    TTEntry tag = make_tag(full_key);
+
+    // deeper positions are worth more, as they took more work to compute
+    TTEntry depth = static_cast<TTEntry>(G::NUM_STONES - popcount<G>(our_bb|their_bb)) << TT_DEPTH_SHIFT;
+
+    // files are stored as seen from the canonical position
+    if (move_file != TT_NO_MOVE && mirrored) move_file = G::WIDTH - 1 - move_file;
+    TTEntry move = static_cast<TTEntry>(move_file + 1) << MOVE_SHIFT;
+
+    TTEntry entry = tag | depth | move;
+
+    Slot * slots = m_buckets[bucket_index(full_key)].slots;
+
+    // pick the slot to overwrite
+    Slot * victim = &slots[0];
+    TTEntry victim_depth = TT_DEPTH_MASK + 1;
+    bool evicted = true;
+
+    for (size_t i = 0; i < BUCKET_SLOTS; ++i)
+    {
+        TTEntry current = load(slots[i]);
+
+        // same position: keep its move if we have none, and its bounds if tighter
+        if (holds(slots[i], current, tag, full_key))
+        {
+            if (!move) entry |= current & MOVE_MASK;
+            upper_bound = std::min(upper_bound, static_cast<int>(static_cast<int8_t>(current)));
+            lower_bound = std::max(lower_bound, static_cast<int>((current & TT_LOWER_MASK) >> TT_LOWER_SHIFT) + TT_NO_LOWER_BOUND);
+            victim = &slots[i];
+            evicted = false;
+            break;
+        }
+
+        // unused slot, or used by an older generation: take it right away
+        if ((current & TT_LIVE_MASK) != (TT_USED_BIT | m_generation))
+        {
+            victim = &slots[i];
+            evicted = false;
+            break;
+        }
+
+        // else remember the shallowest entry
+        if ((current & TT_DEPTH_MASK) < victim_depth)
+        {
+            victim = &slots[i];
+            victim_depth = current & TT_DEPTH_MASK;
+        }
+    }
+
+    entry |= static_cast<uint8_t>(upper_bound);
+    entry |= static_cast<TTEntry>(lower_bound - TT_NO_LOWER_BOUND) << TT_LOWER_SHIFT;
+
+    store(*victim, entry, full_key);
+
+    return evicted;
 }
 
-constexpr size_t make_index(TTKey full_key)
+template <class G>
+int8_t BasicTranspositionTable<G>::probe(Board our_bb, Board their_bb, int & lower_bound, int & move_file) const
 {
-    // take full key mod our (coprime) number of entries
-    return full_key % TT_NUM_ENTRIES;
+    bool mirrored;
+    Board full_key = make_canonical_key<G>(our_bb, their_bb, mirrored);
+    TTEntry tag = make_tag(full_key);
+
+    const Slot * slots = m_buckets[bucket_index(full_key)].slots;
+
+    for (size_t i = 0; i < BUCKET_SLOTS; ++i)
+    {
+        TTEntry entry = load(slots[i]);
+
+        // if the truncated key matches the computed truncated key, return the associated value
+        // (Chinese remainder theorem)
+        if (holds(slots[i], entry, tag, full_key))
+        {
+            move_file = static_cast<int>((entry & MOVE_MASK) >> MOVE_SHIFT) - 1;
+            if (move_file != TT_NO_MOVE && mirrored) move_file = G::WIDTH - 1 - move_file;
+
+            lower_bound = static_cast<int>((entry & TT_LOWER_MASK) >> TT_LOWER_SHIFT) + TT_NO_LOWER_BOUND;
+
+            return static_cast<int8_t>(entry);
+        }
+    }
+
+    lower_bound = TT_NO_LOWER_BOUND;
+    move_file = TT_NO_MOVE;
+    return TT_NOT_FOUND; // no match
 }
 
-void TranspositionTable::clear()
+template <class G>
+size_t BasicTranspositionTable<G>::used_entries() const
 {
-    // keys are set to 0 by default
-    std::memset(m_keys, 0x00, TT_NUM_ENTRIES*sizeof(m_keys[0]));
+    size_t count = 0;
+
+    for (size_t b = 0; b < m_num_buckets; ++b)
+    {
+        for (const Slot & slot : m_buckets[b].slots) count += (load(slot) & TT_LIVE_MASK) == (TT_USED_BIT | m_generation);
+    }
 
-    // values are set to INT8_MIN by default
-    std::memset(m_vals, TT_NOT_FOUND, TT_NUM_ENTRIES*sizeof(m_vals[0]));
+    return count;
+}
+
+template <class G>
+typename BasicTranspositionTable<G>::FileHeader BasicTranspositionTable<G>::make_file_header() const
+{
+    FileHeader header;
+    header.magic = TT_FILE_MAGIC;
+    header.version = TT_FILE_VERSION;
+    header.key_bits = KEY_BITS;
+    header.bucket_bits = __builtin_ctzll(BUCKET_SLOTS);
+    header.num_buckets = m_num_buckets;
+    header.num_stones = G::NUM_STONES;
+    header.bucket_size = sizeof(Bucket);
+    header.generation = m_generation >> TT_GENERATION_SHIFT;
+    header.reserved = 0;
+    return header;
 }
 
-void TranspositionTable::save(Bitboard our_bb, Bitboard their_bb, int value_bound)
+template <class G>
+bool BasicTranspositionTable<G>::save_to_file(const char * path) const
 {
-    TTKey full_key = make_key(our_bb, their_bb);
+    HeaderedFileWriter file;
+    if (!file.open(path, TT_FILE_HEADER_SIZE)) return false;
 
-    // get index for entry
-    size_t index = make_index(full_key);
+    // buckets, streamed in large blocks
+    const char * data = reinterpret_cast<const char *>(m_buckets);
+    size_t left = m_num_buckets*sizeof(m_buckets[0]);
 
-    // only store truncated key (Chinese remainder theorem)
-    m_keys[index] = static_cast<TTPartialKey>(full_key);
+    while (left)
+    {
+        size_t block = std::min(left, TT_FILE_BLOCK_SIZE);
+        if (!file.write(data, block)) break;
+        data += block;
+        left -= block;
+    }
 
-    // store value
-    m_vals[index] = value_bound;
+    FileHeader header = make_file_header();
+    return file.close(&header, sizeof(header));
 }
 
-int8_t TranspositionTable::probe(Bitboard our_bb, Bitboard their_bb) const
+template <class G>
+bool BasicTranspositionTable<G>::load_from_file(const char * path)
 {
-    TTKey full_key = make_key(our_bb, their_bb);
-    
-    // get index for entry
-    size_t index = make_index(full_key);
+    std::FILE * file = std::fopen(path, "rb");
+    if (!file) return false;
+
+    char header_block[TT_FILE_HEADER_SIZE];
+    FileHeader header;
+    FileHeader expected = make_file_header();
+
+    if (std::fread(header_block, sizeof(header_block), 1, file) != 1)
+    {
+        std::fclose(file);
+        return false;
+    }
+
+    std::memcpy(&header, header_block, sizeof(header));
+
+    // a table from another build would return wrong scores, reject it (only its size may differ)
+    expected.num_buckets = header.num_buckets;
+    expected.generation = header.generation;
+    bool valid_size = header.num_buckets >= MIN_BUCKETS && header.num_buckets <= TT_MAX_BUCKETS && header.num_buckets % 2 == 1;
+
+    if (std::memcmp(&header, &expected, sizeof(header)) != 0 || !valid_size || header.generation > TT_MAX_GENERATION)
+    {
+        std::fclose(file);
+        return false;
+    }
+
+    // a fresh mapping is already empty, should the file be truncated
+    if (header.num_buckets != m_num_buckets && !allocate(header.num_buckets, m_pages == TTPages::Explicit))
+    {
+        std::fclose(file);
+        return false;
+    }
+
+    // the file's entries are live in its generation
+    m_generation = static_cast<TTEntry>(header.generation) << TT_GENERATION_SHIFT;
+
+    char * data = reinterpret_cast<char *>(m_buckets);
+    size_t left = m_num_buckets*sizeof(m_buckets[0]);
+    bool ok = true;
+
+    while (ok && left)
+    {
+        size_t block = std::min(left, TT_FILE_BLOCK_SIZE);
+        ok = std::fread(data, 1, block, file) == block;
+        data += block;
+        left -= block;
+    }
+
+    std::fclose(file);
+
+    // a partially loaded table is inconsistent
+    if (!ok) clear();
+
+    return ok;
+}
+
 
-    // if the truncated key matches the computed truncated key, return the associated value
-    // (Chinese remainder theorem), else there is no match
-    return (m_keys[index] == static_cast<TTPartialKey>(full_key)) ? m_vals[index] : TT_NOT_FOUND;
-}
\ No newline at end of file
+// the standard board's table, and those of the other board sizes the solver is built for (see search.cpp)
+template class BasicTranspositionTable<StandardGeometry>;
+template class BasicTranspositionTable<BoardGeometry<6, 5>>;
+template class BasicTranspositionTable<BoardGeometry<5, 4>>;
+template class BasicTranspositionTable<BoardGeometry<4, 4>>;
+template class BasicTranspositionTable<BoardGeometry<8, 7>>;
+template class BasicTranspositionTable<BoardGeometry<9, 7>>;
@@ -4,54 +4,336 @@
 
 #include "constants.h"
 
+#include <type_traits>
+
 
 // used to store a position key
 using TTKey = Bitboard;
 
 // used in conjunction with Chinese theorem to reduce key storage size
 using TTPartialKey = uint32_t;
+static_assert(sizeof(TTPartialKey) * 8 == TT_PARTIAL_KEY_BITS, "partial keys are stored whole");
+
+/// @brief Build the key of a position on a board of any size.
+/// @tparam G The board's geometry.
+/// @param our_bb Our pieces.
+/// @param their_bb Our opponent's pieces.
+/// @return The position's key, below 2^G::NUM_BITS.
+template <class G>
+constexpr typename G::Board make_key(typename G::Board our_bb, typename G::Board their_bb)
+{
+    // We use the sum of the bitboard of all pieces and our bitboard as a key.
+    // This is a unique, small and fast representation of the position.
+    return ((our_bb | their_bb) + our_bb);
+}
+
+/// @brief Build the key shared by a position and its mirror image on a board of any size.
+/// @tparam G The board's geometry.
+/// @param our_bb Our pieces.
+/// @param their_bb Our opponent's pieces.
+/// @return The smaller of the position's key and its mirror's key.
+template <class G>
+constexpr typename G::Board make_canonical_key(typename G::Board our_bb, typename G::Board their_bb)
+{
+    // no carry crosses files in make_key's sum, so mirroring the key mirrors the position
+    typename G::Board key = make_key<G>(our_bb, their_bb);
+    typename G::Board mirrored;
+    if constexpr (std::is_same_v<G, StandardGeometry>) mirrored = mirror_bb(key);
+    else mirrored = mirror<G>(key);
+    return mirrored < key ? mirrored : key;
+}
 
-class TranspositionTable
+/// @brief Build the key of a position.
+/// @param our_bb Our pieces.
+/// @param their_bb Our opponent's pieces.
+/// @return The position's key.
+constexpr TTKey make_key(Bitboard our_bb, Bitboard their_bb)
+{
+    return make_key<StandardGeometry>(our_bb, their_bb);
+}
+
+/// @brief Build the key shared by a position and its mirror image, which have the same value.
+/// @param our_bb Our pieces.
+/// @param their_bb Our opponent's pieces.
+/// @return The smaller of the position's key and its mirror's key.
+constexpr TTKey make_canonical_key(Bitboard our_bb, Bitboard their_bb)
+{
+    return make_canonical_key<StandardGeometry>(our_bb, their_bb);
+}
+
+// A packed entry, read and written with single atomic 64-bit accesses so that
+// threads can share the table without locks and never see a torn key/value pair.
+using TTEntry = uint64_t;
+
+// Entry layout: bits 0-7 upper bound, bits 8-39 partial key, bit 40 set when the entry is used,
+// bits 41-46 depth left (number of empty squares) of the position,
+// bits 47-49 file of the best or cut-off move plus one (0 if none), as seen from the canonical orientation,
+// bits 50-56 lower bound minus TT_NO_LOWER_BOUND (0 if none),
+// bits 57-63 generation of the table when the entry was saved: entries of older generations are unused.
+constexpr int TT_KEY_SHIFT = 8;
+constexpr TTEntry TT_USED_BIT = 1ULL << 40;
+constexpr int TT_DEPTH_SHIFT = 41;
+constexpr TTEntry TT_DEPTH_MASK = 0x3FULL << TT_DEPTH_SHIFT;
+constexpr int TT_MOVE_SHIFT = 47;
+constexpr TTEntry TT_MOVE_MASK = 0x7ULL << TT_MOVE_SHIFT;
+constexpr int TT_LOWER_SHIFT = 50;
+constexpr TTEntry TT_LOWER_MASK = 0x7FULL << TT_LOWER_SHIFT;
+constexpr int TT_GENERATION_SHIFT = 57;
+constexpr TTEntry TT_GENERATION_MASK = ~0ULL << TT_GENERATION_SHIFT;
+constexpr uint32_t TT_MAX_GENERATION = TT_GENERATION_MASK >> TT_GENERATION_SHIFT;
+
+// Wide entry layout, for boards whose keys the bucket index and the partial key can't identify (see TT_MAX_BUCKETS)
+// or whose move files don't fit 3 bits: a check word, the key's low 64 bits xor the data word, then the data word.
+// The data word is laid out as an entry, but for bits 8-35 holding the key's bits 64-91 instead of the partial key
+// and bits 36-39 holding the move file plus one. The words are read and written separately: a probe racing a save
+// may read the check word of one entry with the data word of another, which then (all but certainly) fails the check.
+constexpr int TT_WIDE_HIGH_KEY_BITS = 28;
+constexpr int TT_WIDE_MOVE_SHIFT = 36;
+constexpr TTEntry TT_WIDE_MOVE_MASK = 0xFULL << TT_WIDE_MOVE_SHIFT;
+
+/// @brief An entry of the wide layout.
+struct TTWideEntry
+{
+    uint64_t check; // the key's low 64 bits xor data
+    TTEntry data;
+};
+
+/// @brief A group of entries sharing one cache line. A position may be stored in any slot of its bucket.
+/// @tparam Slot The entry, TTEntry or TTWideEntry.
+template <class Slot>
+struct alignas(64) TTBucket
+{
+    Slot slots[TT_BUCKET_SLOTS * sizeof(TTEntry) / sizeof(Slot)]; // as many bytes whatever the layout
+};
+
+static_assert(sizeof(TTBucket<TTEntry>) == 64 && sizeof(TTBucket<TTWideEntry>) == 64, "a bucket must fill exactly one cache line");
+static_assert(NUM_STONES == StandardGeometry::NUM_STONES, "NUM_STONES is the standard board's");
+
+/// @brief The kind of pages backing the table.
+enum class TTPages
+{
+    Normal,
+    Transparent, // transparent huge pages were asked for, the kernel uses them when it can
+    Explicit // reserved huge pages (MAP_HUGETLB)
+};
+
+/// @brief Bounds of position values and refutation moves, shared by all search threads without locks.
+/// An entry holds for its position whatever was searched before, so the table never needs clearing between searches.
+/// @tparam G The geometry of the board whose positions are stored.
+template <class G>
+class BasicTranspositionTable
 {
 public:
-    /// @brief Create a TranspositionTable. Beware of its 512MB size!
-    TranspositionTable()
-    {
-        m_keys = new TTPartialKey[TT_NUM_ENTRIES]; // uninitialized memory
-        m_vals = new int8_t[TT_NUM_ENTRIES]; // uninitialized memory
-        clear(); // initialize the table
-    }
+    using Board = typename G::Board;
+
+    static constexpr int KEY_BITS = G::NUM_BITS;
+
+    // entries are single words, unless fewer than 2^32 buckets can't identify the keys or the move files need 4 bits
+    static constexpr bool WIDE_ENTRIES = KEY_BITS >= TT_PARTIAL_KEY_BITS + 32 || G::WIDTH > 7;
+    using Slot = std::conditional_t<WIDE_ENTRIES, TTWideEntry, TTEntry>;
+    using Bucket = TTBucket<Slot>;
+    static constexpr size_t BUCKET_SLOTS = sizeof(Bucket::slots) / sizeof(Slot);
+
+    // keys are below 2^KEY_BITS, and identified by MIN_BUCKETS buckets or more with their partial key
+    // (wide entries store the whole key)
+    static constexpr size_t MIN_BUCKETS = !WIDE_ENTRIES && KEY_BITS > TT_PARTIAL_KEY_BITS ? (1ULL << (KEY_BITS - TT_PARTIAL_KEY_BITS)) + 1 : 3;
+    static constexpr int RECIPROCAL_SHIFT = KEY_BITS + 32; // fixed point of the reciprocal of the number of buckets
+
+    // fields of the entries (or their data words) which depend on the layout
+    static constexpr TTEntry KEY_MASK = (WIDE_ENTRIES ? (1ULL << TT_WIDE_HIGH_KEY_BITS) - 1 : 0xFFFFFFFFULL) << TT_KEY_SHIFT;
+    static constexpr int MOVE_SHIFT = WIDE_ENTRIES ? TT_WIDE_MOVE_SHIFT : TT_MOVE_SHIFT;
+    static constexpr TTEntry MOVE_MASK = WIDE_ENTRIES ? TT_WIDE_MOVE_MASK : TT_MOVE_MASK;
+
+    static_assert(MIN_BUCKETS <= TT_MAX_BUCKETS, "keys must be identified by fewer than 2^32 buckets");
+    static_assert(!WIDE_ENTRIES || KEY_BITS <= 64 + TT_WIDE_HIGH_KEY_BITS, "keys must fit the wide entries");
+    static_assert(G::NUM_STONES <= 0x3F, "depth left must fit its 6 bits");
+    static_assert(G::WIDTH <= (MOVE_MASK >> MOVE_SHIFT), "move files plus one must fit their bits");
+    static_assert(G::NUM_STONES - TT_NO_LOWER_BOUND <= 0x7F, "lower bounds must fit their 7 bits");
+
+    /// @brief Create an empty table of TT_DEFAULT_SIZE_MB.
+    /// Its memory is only mapped: pages are allocated, zeroed, when first touched.
+    /// @throw std::bad_alloc if the memory cannot be mapped.
+    BasicTranspositionTable();
     
     /// @brief NO COPY CONSTRUCTOR ALLOWED 
-    TranspositionTable(const TranspositionTable&) = delete;
+    BasicTranspositionTable(const BasicTranspositionTable&) = delete;
 
-    ~TranspositionTable()
-    {
-        delete m_keys;
-        delete m_vals;
-    }
+    ~BasicTranspositionTable();
+
+    /// @brief Replace the table with an empty one of about a given size, in a prime number of buckets.
+    /// Must not run concurrently with a search.
+    /// @param megabytes The size, clamped to the sizes the keying allows (8MB to 256GB on the standard board).
+    /// @param explicit_huge_pages Whether to use reserved huge pages (MAP_HUGETLB), falling back to transparent
+    /// huge pages if none are available. Reserved pages are not shared copy-on-write by forked processes as
+    /// reliably: a process running out of them is killed.
+    /// @return Whether the memory was mapped. If not, the table is left untouched.
+    bool resize(size_t megabytes, bool explicit_huge_pages = false);
 
-    /// @brief Zero the transposition table's contents, deleting its entries.
+    /// @brief Get the number of buckets.
+    size_t num_buckets() const { return m_num_buckets; }
+
+    /// @brief Get the kind of pages backing the table.
+    TTPages pages() const { return m_pages; }
+
+    /// @brief Delete the transposition table's entries, by starting a new generation:
+    /// entries of older ones count as unused. Once every TT_MAX_GENERATION clears, the table is zeroed for real,
+    /// by handing its pages back to the kernel (zeroing all hardware threads if it refuses).
+    /// Must not run concurrently with a search.
     void clear();
     
-    /// @brief Save an entry into the transposition table, overwriting previous entries.
+    /// @brief Save an entry into the transposition table.
+    /// An existing entry for the same position is updated, its bounds intersected with the new ones
+    /// (both are proven, whichever window found them), else an unused slot of the bucket is taken,
+    /// else the entry with the least depth left (the cheapest to recompute) is replaced.
+    /// Safe to call concurrently with other saves and probes.
     /// @param our_bb Our pieces.
     /// @param their_bb Our opponent's pieces.
-    /// @param value_bound The upper bound of the position's value.
-    void save(Bitboard our_bb, Bitboard their_bb, int value_bound);
+    /// @param upper_bound The upper bound of the position's value.
+    /// @param lower_bound The lower bound of the position's value, TT_NO_LOWER_BOUND if none.
+    /// @param move_file The file (0-6) of the move which was best or caused a cut-off, TT_NO_MOVE if none.
+    /// An existing entry for the same position keeps its move if none is given.
+    /// @return Whether another position's entry was evicted.
+    bool save(Board our_bb, Board their_bb, int upper_bound, int lower_bound, int move_file);
     
     /// @brief Check whether an entry exists for a given key in the transposition table.
+    /// Safe to call concurrently with saves and other probes.
     /// @param our_bb Our pieces.
     /// @param their_bb Their pieces.
+    /// @param lower_bound Receives the lower bound stored with the entry, TT_NO_LOWER_BOUND if there is none.
+    /// @param move_file Receives the file of the move stored with the entry, TT_NO_MOVE if there is none.
     /// @return The upper bound stored for the key if it exists, TT_NOT_FOUND if it wasn't found.
-    int8_t probe(Bitboard our_bb, Bitboard their_bb) const;
+    int8_t probe(Board our_bb, Board their_bb, int & lower_bound, int & move_file) const;
+
+    /// @brief Count the entries in use, by scanning the whole table.
+    /// @return The number of used entries.
+    size_t used_entries() const;
+
+    /// @brief Write the whole table to a file, so that a later run can start with it warm.
+    /// Must not run concurrently with a search.
+    /// @param path The file's path, replaced only once the whole file is written.
+    /// @return Whether the file was written successfully.
+    bool save_to_file(const char * path) const;
+
+    /// @brief Replace the table's contents with a file written by save_to_file, resizing the table to the file's.
+    /// Files from another format version or table geometry are rejected and the table is left untouched;
+    /// a file truncated while reading leaves the table cleared.
+    /// Must not run concurrently with a search.
+    /// @param path The file's path.
+    /// @return Whether the file was loaded successfully.
+    bool load_from_file(const char * path);
+
+    /// @brief Start loading the bucket of a position into the cache, ahead of a probe or save.
+    /// @param our_bb Our pieces.
+    /// @param their_bb Their pieces.
+    void prefetch(Board our_bb, Board their_bb) const
+    {
+        __builtin_prefetch(&m_buckets[bucket_index(make_canonical_key<G>(our_bb, their_bb))]);
+    }
 
 private:
-    TTPartialKey * m_keys; // a pointer to the full key entries
-    int8_t * m_vals; // a pointer to the values
-    // A full entry consists of an entry in each of these arrays.
+    /// @brief Find the bucket of a key, key % m_num_buckets, with a multiplication by the reciprocal
+    /// instead of a division. Exact for keys below 2^KEY_BITS and fewer than 2^32 buckets.
+    /// Wide entries store the whole key, so any bucket will do: theirs is picked by Fibonacci hashing.
+    size_t bucket_index(Board key) const
+    {
+        if constexpr (WIDE_ENTRIES)
+        {
+            uint64_t high = static_cast<uint64_t>(static_cast<unsigned __int128>(key) >> 64);
+            uint64_t hash = (static_cast<uint64_t>(key) ^ high * TT_WIDE_HASH_MULTIPLIER) * TT_WIDE_HASH_MULTIPLIER;
+            return static_cast<uint64_t>((static_cast<unsigned __int128>(hash) * m_num_buckets) >> 64);
+        }
+        else
+        {
+            uint64_t quotient = static_cast<uint64_t>((static_cast<unsigned __int128>(key) * m_reciprocal) >> RECIPROCAL_SHIFT);
+            return key - quotient * m_num_buckets;
+        }
+    }
+
+    /// @brief Replace the table with an empty one.
+    /// @param num_buckets The number of buckets, coprime with 2^32 and within [MIN_BUCKETS; TT_MAX_BUCKETS].
+    /// @return Whether the memory was mapped. If not, the table is left untouched.
+    bool allocate(size_t num_buckets, bool explicit_huge_pages);
+
+    /// @brief Header of a transposition table file, padded to TT_FILE_HEADER_SIZE bytes.
+    /// All fields must match the running binary for the file to be loaded.
+    struct FileHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t key_bits;
+        uint32_t bucket_bits;
+        uint64_t num_buckets;
+        uint32_t num_stones;
+        uint32_t bucket_size;
+        uint32_t generation;
+        uint32_t reserved; // zero, so that the header has no padding
+    };
+
+    static_assert(sizeof(FileHeader) <= TT_FILE_HEADER_SIZE, "header must fit its padded block");
+
+    /// @brief Build the header describing this table.
+    FileHeader make_file_header() const;
+
+    /// @brief Build the part of an entry (or of its data word) which identifies its position in the current generation.
+    /// @param full_key The position's key.
+    /// @return The used bit, partial key (the key's high bits if wide) and generation, in place.
+    TTEntry make_tag(Board full_key) const
+    {
+        // only store truncated key (Chinese remainder theorem), wide entries keep the rest in their check word
+        TTEntry key_bits;
+        if constexpr (WIDE_ENTRIES) key_bits = static_cast<uint64_t>(static_cast<unsigned __int128>(full_key) >> 64);
+        else key_bits = static_cast<TTPartialKey>(full_key);
+        return TT_USED_BIT | (key_bits << TT_KEY_SHIFT) | m_generation;
+    }
+
+    /// @brief Read an entry, or the data word of a wide one.
+    static TTEntry load(const Slot & slot)
+    {
+        if constexpr (WIDE_ENTRIES) return __atomic_load_n(&slot.data, __ATOMIC_RELAXED);
+        else return __atomic_load_n(&slot, __ATOMIC_RELAXED);
+    }
+
+    /// @brief Check whether a slot holds a position's entry.
+    /// @param slot The slot.
+    /// @param entry The slot's entry, as read by load.
+    /// @param tag The position's tag, as built by make_tag.
+    /// @param full_key The position's key.
+    static bool holds(const Slot & slot, TTEntry entry, TTEntry tag, Board full_key)
+    {
+        if ((entry & (TT_USED_BIT | KEY_MASK | TT_GENERATION_MASK)) != tag) return false;
+        if constexpr (WIDE_ENTRIES) return (__atomic_load_n(&slot.check, __ATOMIC_RELAXED) ^ entry) == static_cast<uint64_t>(full_key);
+        else return true;
+    }
+
+    /// @brief Write an entry into a slot.
+    /// @param slot The slot.
+    /// @param entry The entry, or the data word of a wide one.
+    /// @param full_key The position's key.
+    static void store(Slot & slot, TTEntry entry, Board full_key)
+    {
+        // relaxed ordering is enough: the entry is self-contained, or checked
+        if constexpr (WIDE_ENTRIES)
+        {
+            __atomic_store_n(&slot.check, static_cast<uint64_t>(full_key) ^ entry, __ATOMIC_RELAXED);
+            __atomic_store_n(&slot.data, entry, __ATOMIC_RELAXED);
+        }
+        else __atomic_store_n(&slot, entry, __ATOMIC_RELAXED);
+    }
+
+    /// @brief Zero the buckets.
+    void wipe();
+
+    Bucket * m_buckets = nullptr; // a pointer to the buckets of packed entries
+    size_t m_num_buckets = 0;
+    uint64_t m_reciprocal = 0; // ceil(2^RECIPROCAL_SHIFT / m_num_buckets), unused by wide entries
+    size_t m_mapped_bytes = 0; // size of the mapping starting at m_buckets
+    TTPages m_pages = TTPages::Normal;
+    TTEntry m_generation = 0; // the current generation, in place
 };
 
 
-// The global transposition table.
+// the transposition table of the standard board
+using TranspositionTable = BasicTranspositionTable<StandardGeometry>;
+
+// The global transposition table, shared by all search threads.
 extern TranspositionTable tt;
\ No newline at end of file
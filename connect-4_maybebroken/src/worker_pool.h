@@ -0,0 +1,50 @@
+#pragma once
+
+#include "search.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+
+/// @brief Set up the current process's searches for a pool of workers: each worker runs a single-threaded search,
+/// as the parallelism comes from the pool rather than from lazy SMP, and nothing is printed.
+inline void prepare_worker_search()
+{
+    set_search_threads(1);
+    set_search_verbose(false);
+}
+
+/// @brief Solve a chunk of independent jobs on a pool of worker threads, each worker taking the next job not
+/// started yet. The calling thread is one of the workers.
+/// @tparam Result The result of a job, default-constructible.
+/// @param count The number of jobs.
+/// @param num_workers The number of worker threads, at least 1.
+/// @param results Receives the results, in job order.
+/// @param solve Solves the job of an index, returning its Result. Called concurrently.
+template <typename Result, typename Solve>
+void solve_chunk(size_t count, int num_workers, std::vector<Result> & results, Solve solve)
+{
+    results.assign(count, Result{});
+    std::atomic<size_t> next{0};
+
+    auto work = [&]()
+    {
+        for (size_t i = next++; i < count; i = next++)
+        {
+            results[i] = solve(i);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (int w = 1; w < std::min<int>(num_workers, count); ++w)
+    {
+        workers.emplace_back(work);
+    }
+
+    work();
+
+    for (auto & worker : workers) worker.join();
+}
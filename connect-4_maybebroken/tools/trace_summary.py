@@ -0,0 +1,125 @@
+"""Summarize a search trace written by `connect4 --trace FILE` (see src/trace.h).
+
+Reports where the traced nodes went: the positions whose subtrees took the most nodes, and the cut-offs found
+late in the move order, which are the nodes whose move ordering cost the most.
+Positions are printed as "our,their" bitboards (side to move first), which `connect4 --position` accepts.
+
+Usage: python3 trace_summary.py TRACE [--top N] [--depth D]
+"""
+
+import argparse
+import collections
+import struct
+import sys
+
+TRACE_FILE_MAGIC = 0x52543443  # "C4TR"
+TRACE_FILE_VERSION = 1
+TRACE_FILE_HEADER_SIZE = 32
+TRACE_RECORD_SIZE = 16
+
+FILE_BITS = 7  # bits per file of a bitboard, 7 files
+EXITS = ["all moves", "cut-off", "no moves", "tt lower", "pruned", "etc", "threat", "stopped"]
+CUTOFF = 1
+
+
+def decode_key(key):
+    """Rebuild the position of a key (all + our, per file: 2^h - 1 stones plus ours never carries over)."""
+    our = their = 0
+    for f in range(7):
+        v = (key >> (FILE_BITS * f)) & ((1 << FILE_BITS) - 1)
+        height = (v + 1).bit_length() - 1
+        all_f = (1 << height) - 1
+        our_f = v - all_f
+        our |= our_f << (FILE_BITS * f)
+        their |= (all_f & ~our_f) << (FILE_BITS * f)
+    return "%d,%d" % (our, their)
+
+
+def read_trace(path):
+    with open(path, "rb") as f:
+        data = f.read()
+
+    if len(data) < TRACE_FILE_HEADER_SIZE:
+        sys.exit("%s: not a trace" % path)
+
+    magic, version, record_size, num_stones, num_records, num_dropped = struct.unpack_from("<IIIIQQ", data)
+    if magic != TRACE_FILE_MAGIC or version != TRACE_FILE_VERSION or record_size != TRACE_RECORD_SIZE:
+        sys.exit("%s: not a version %d trace (unfinished?)" % (path, TRACE_FILE_VERSION))
+    if len(data) != TRACE_FILE_HEADER_SIZE + num_records * TRACE_RECORD_SIZE:
+        sys.exit("%s: size doesn't match the header" % path)
+
+    return data[TRACE_FILE_HEADER_SIZE:], num_records, num_dropped
+
+
+def to_int8(byte):
+    return byte - 256 if byte >= 128 else byte
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Summarize a connect4 search trace.")
+    parser.add_argument("trace")
+    parser.add_argument("--top", type=int, default=20, help="lines per list (default 20)")
+    parser.add_argument("--depth", type=int, help="only list positions with this many empty squares")
+    args = parser.parse_args()
+
+    data, num_records, num_dropped = read_trace(args.trace)
+
+    exits = collections.Counter()
+    per_depth = collections.defaultdict(lambda: [0, 0])  # records, nodes
+    cut_index = collections.defaultdict(lambda: [0] * 8)  # per depth, cut-offs per move index
+    hot = collections.defaultdict(lambda: [0, 0, 0])  # per key: visits, nodes, depth
+    late = []  # cut-offs after the first move: nodes, key, depth, index, file, alpha, beta
+
+    for node_word, result_word in struct.iter_unpack("<QQ", data):
+        key = node_word & ((1 << 49) - 1)
+        depth = (node_word >> 49) & 63
+        move_file = ((node_word >> 55) & 7) - 1
+        move_index = (node_word >> 58) & 7
+        exit_kind = (result_word >> 24) & 0xFF
+        nodes = result_word >> 32
+
+        exits[exit_kind] += 1
+        per_depth[depth][0] += 1
+        per_depth[depth][1] += nodes
+
+        if args.depth is None or depth == args.depth:
+            entry = hot[key]
+            entry[0] += 1
+            entry[1] += nodes
+            entry[2] = depth
+
+        if exit_kind == CUTOFF:
+            cut_index[depth][move_index] += 1
+            if move_index > 0 and (args.depth is None or depth == args.depth):
+                late.append((nodes, key, depth, move_index, move_file,
+                             to_int8(result_word & 0xFF), to_int8((result_word >> 8) & 0xFF)))
+
+    print("%d records, %d dropped" % (num_records, num_dropped))
+    print("exits: " + ", ".join("%s %d" % (EXITS[k], n) for k, n in sorted(exits.items())))
+
+    print("\nper depth left (records, nodes in their subtrees, cut-offs by the 1st/2nd/later move):")
+    for depth in sorted(per_depth, reverse=True):
+        records, nodes = per_depth[depth]
+        cuts = cut_index[depth]
+        total = sum(cuts)
+        order = ""
+        if total:
+            order = "  cut-offs %d: %.1f%% / %.1f%% / %.1f%%" % (
+                total, 100.0 * cuts[0] / total, 100.0 * cuts[1] / total, 100.0 * sum(cuts[2:]) / total)
+        print("  %2d: %9d records %12d nodes%s" % (depth, records, nodes, order))
+
+    print("\nhot subtrees (nodes summed over the position's visits):")
+    print("  %12s %6s %5s  %s" % ("nodes", "visits", "depth", "position"))
+    for key, (visits, nodes, depth) in sorted(hot.items(), key=lambda item: -item[1][1])[:args.top]:
+        print("  %12d %6d %5d  %s" % (nodes, visits, depth, decode_key(key)))
+
+    print("\nlate cut-offs (the moves searched before the refutation were wasted):")
+    print("  %12s %5s %5s %6s %8s  %s" % ("nodes", "depth", "index", "column", "window", "position"))
+    late.sort(reverse=True)
+    for nodes, key, depth, move_index, move_file, alpha, beta in late[:args.top]:
+        print("  %12d %5d %5d %6d %8s  %s" % (nodes, depth, move_index, move_file + 1,
+                                              "[%d;%d]" % (alpha, beta), decode_key(key)))
+
+
+if __name__ == "__main__":
+    main()